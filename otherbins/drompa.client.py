@@ -0,0 +1,50 @@
+#! /usr/bin/env python
+# -*- coding: utf-8 -*-
+
+import argparse
+import json
+import socket
+import sys
+
+def request(sock, req):
+    """Send a request to drompa+ SERVE and return the response as a dict."""
+    sock.sendall((json.dumps(req) + "\n").encode())
+    buf = b""
+    while not buf.endswith(b"\n"):
+        chunk = sock.recv(4096)
+        if not chunk:
+            break
+        buf += chunk
+    return json.loads(buf.decode())
+
+if(__name__ == '__main__'):
+    parser = argparse.ArgumentParser(description="Client for drompa+ SERVE --socket <socket>")
+    parser.add_argument("socket", help="Unix domain socket of drompa+ SERVE", type=str)
+    parser.add_argument("command", help="draw, profile or quit", type=str)
+    parser.add_argument("-r", "--region", help="Region to draw (chr:start-end or chr)", type=str)
+    parser.add_argument("-o", "--output", help="Output file (.pdf/.png for draw, .tsv for profile)", type=str)
+    parser.add_argument("--png", help="Output PNG files (default: PDF)", action="store_true")
+
+    args = parser.parse_args()
+
+    req = {"command": args.command}
+    if args.region:
+        chrom, _, pos = args.region.partition(":")
+        req["chr"] = chrom
+        if pos:
+            start, end = pos.replace(",", "").split("-")
+            req["start"] = int(start)
+            req["end"] = int(end)
+    if args.output:
+        req["output"] = args.output
+    if args.command == "draw":
+        req["format"] = "png" if args.png else "pdf"
+
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    sock.connect(args.socket)
+    res = request(sock, req)
+    sock.close()
+
+    print (json.dumps(res))
+    if res.get("status") != "ok":
+        sys.exit(1)
@@ -0,0 +1,61 @@
+#! /usr/bin/env python
+# -*- coding: utf-8 -*-
+
+import numpy as np
+import pandas as pd
+import argparse
+import struct
+import zlib
+import sys
+
+def readTSVMatrix(filename):
+    """The row header is "chromosome, start, end(, name)" for MULTICI and the site name otherwise."""
+    with open(filename) as f:
+        header = f.readline().rstrip("\n").split("\t")
+    if header[:3] != ["chromosome", "start", "end"]:
+        return pd.read_csv(filename, sep="\t", index_col=0)
+
+    indexcol = header[:4] if len(header) > 3 and header[3] == "name" else header[:3]
+    df = pd.read_csv(filename, sep="\t", dtype={x: str for x in indexcol})
+    return df.set_index(indexcol)
+
+def readMatrix(filename):
+    """Read a matrix generated by drompa+ PROFILE/MULTICI.
+    Both TSV (*.tsv) and binary (*.bin, with *.sites.tsv) files are accepted."""
+    if not filename.endswith(".bin"):
+        return readTSVMatrix(filename)
+
+    with open(filename, "rb") as f:
+        if f.read(8) != b"DDMATRIX":
+            print ("Error: " + filename + " is not a drompa+ matrix file.")
+            sys.exit()
+        version, ncol, collen = struct.unpack("<iii", f.read(12))
+        colname = f.read(collen).decode().split("\t")
+
+        blocks = []
+        while True:
+            head = f.read(8)
+            if len(head) < 8:
+                break
+            nrow, size = struct.unpack("<ii", head)
+            array = np.frombuffer(zlib.decompress(f.read(size)), dtype="<f4")
+            blocks.append(array.reshape(nrow, ncol))
+
+    values = np.vstack(blocks) if blocks else np.empty((0, ncol), dtype="<f4")
+    sites = pd.read_csv(filename[:-len(".bin")] + ".sites.tsv", sep="\t", dtype=str)
+    if sites.shape[1] == 1:
+        index = pd.Index(sites.iloc[:,0])
+    else:
+        index = pd.MultiIndex.from_frame(sites)
+
+    return pd.DataFrame(values, index=index, columns=colname)
+
+if(__name__ == '__main__'):
+    parser = argparse.ArgumentParser()
+    parser.add_argument("input", help="Input matrix (.bin or .tsv file)", type=str)
+    parser.add_argument("-o","--output", help="Output TSV file (default: stdout)", type=str)
+
+    args = parser.parse_args()
+
+    df = readMatrix(args.input)
+    df.to_csv(args.output if args.output else sys.stdout, sep="\t", float_format="%g")
@@ -0,0 +1,95 @@
+/* Copyright(c) Ryuichiro Nakato <rnakato@iam.u-tokyo.ac.jp>
+ * All rights reserved.
+ */
+#ifndef _CHRDICTIONARY_HPP_
+#define _CHRDICTIONARY_HPP_
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+#include "../../submodules/SSP/common/inline.hpp"
+
+/* Dense integer IDs of chromosome names.
+ * Names with or without "chr" and MT/M are the same chromosome.
+ * drompa+ registers the genome table first, so the chromosomes of the genome table have
+ * the IDs 0, 1, ... in its order; other names (e.g. in BED files) get the following IDs.
+ * Per-chromosome data is kept in ChrVector indexed by the ID. */
+class ChrDictionary {
+  mutable std::mutex mtx;
+  std::unordered_map<std::string, int32_t> ids;
+  std::vector<std::string> names;
+
+  static std::string normalize(const std::string &name) {
+    std::string str(rmchr(name));
+    if (str == "MT") str = "M";
+    return str;
+  }
+
+public:
+  ChrDictionary() {}
+  ChrDictionary(const ChrDictionary &) = delete;
+  ChrDictionary & operator=(const ChrDictionary &) = delete;
+
+  int32_t intern(const std::string &name) {
+    std::string key(normalize(name));
+    std::lock_guard<std::mutex> lock(mtx);
+    auto itr = ids.find(key);
+    if (itr != ids.end()) return itr->second;
+    int32_t id(names.size());
+    ids.emplace(key, id);
+    names.emplace_back(rmchr(name));
+    return id;
+  }
+  // -1 for names not registered
+  int32_t getID(const std::string &name) const {
+    std::string key(normalize(name));
+    std::lock_guard<std::mutex> lock(mtx);
+    auto itr = ids.find(key);
+    return itr != ids.end() ? itr->second : -1;
+  }
+  // name without "chr" as first registered
+  std::string getName(const int32_t id) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return names.at(id);
+  }
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return names.size();
+  }
+};
+
+inline ChrDictionary & chrdict()
+{
+  static ChrDictionary dict;
+  return dict;
+}
+
+// per-chromosome data indexed by the chromosome ID
+template <class T>
+class ChrVector {
+  std::vector<T> vec;
+
+public:
+  ChrVector() {}
+
+  T & operator[](const int32_t id) {
+    if (id >= static_cast<int32_t>(vec.size())) vec.resize(id+1);
+    return vec[id];
+  }
+  // empty T for chromosomes without data
+  const T & get(const int32_t id) const {
+    static const T empty{};
+    if (id < 0 || id >= static_cast<int32_t>(vec.size())) return empty;
+    return vec[id];
+  }
+  const T & get(const std::string &chr) const { return get(chrdict().getID(chr)); }
+
+  size_t size() const { return vec.size(); }
+  typename std::vector<T>::iterator begin() { return vec.begin(); }
+  typename std::vector<T>::iterator end() { return vec.end(); }
+  typename std::vector<T>::const_iterator begin() const { return vec.begin(); }
+  typename std::vector<T>::const_iterator end() const { return vec.end(); }
+};
+
+#endif  // _CHRDICTIONARY_HPP_
@@ -9,6 +9,16 @@
 
 enum status {INTERGENIC, GENIC, INTRON, EXON, DOWNSTREAM, UPSTREAM, TSS, PARALLEL, DIVERGENT, CONVERGENT};
 
+// category of gtype, set by the parsers (setGeneCategory() in ReadAnnotation.cpp)
+enum class Biotype {
+  ARS, CENTROMERE, TELOMERE, TER,         // SGD, --ars, --ter
+  RRNA, LTR, TRNA,                        // rRNA/snoRNA, LTR/retrotransposon, tRNA (exact match)
+  NOT_DISPLAYED,                          // nonsense_mediated_decay, processed_transcript, retained_intron
+  PROTEIN_CODING, NONCODING_UCSC, LINCRNA, ANTISENSE, OTHER_RNA, PSEUDO, REPEAT,  // substring match in this order
+  OTHERS
+};
+enum class GeneStrand {PLUS, MINUS, NONE};
+
 class genedata {
  public:
   std::string tname;
@@ -31,9 +41,15 @@ class genedata {
   std::string ttype; // transcript biotype
   std::string ttag;  // Gencode tag
 
-  genedata(): txStart(0), txEnd(0), cdsStart(0), cdsEnd(0), exonCount(0) {}
+  Biotype biotype;     // from gtype
+  GeneStrand gstrand;  // from strand
+
+  genedata(): txStart(0), txEnd(0), cdsStart(0), cdsEnd(0), exonCount(0),
+              biotype(Biotype::OTHERS), gstrand(GeneStrand::NONE) {}
 
   int32_t length() const { return (txEnd - txStart); }
+  bool isPlus() const { return gstrand == GeneStrand::PLUS; }
+  bool isMinus() const { return gstrand == GeneStrand::MINUS; }
   void printall() const {
     // if(this){
       std::cout << tname << "\t" << gname << "\t" << tid << "\t" << gid << "\t" << chr << "\t" << strand << "\t" << txStart << "\t" << txEnd << "\t" << cdsStart << "\t" << cdsEnd << "\t" << exonCount << "\tgene source: " << gsrc << "\ttranscript source: "<< tsrc << "\tgene biotype: "<< gtype << "\ttranscript biotype: "<< ttype  << "\ttranscript tag: "<< ttag << "\t";
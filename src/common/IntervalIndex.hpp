@@ -0,0 +1,154 @@
+/* Copyright(c) Ryuichiro Nakato <rnakato@iam.u-tokyo.ac.jp>
+ * All rights reserved.
+ */
+#ifndef _INTERVALINDEX_HPP_
+#define _INTERVALINDEX_HPP_
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <cstdint>
+
+/* Static interval index for one chromosome.
+ * Intervals are sorted by start and augmented with the max end of each subtree
+ * (implicit interval tree in the sorted array, as in cgranges).
+ * Intervals are closed [start, end] as in my_overlap().
+ * Call index() once after all add(). */
+template <class T>
+class IntervalIndex {
+  struct Node {
+    int32_t start;
+    int32_t end;
+    int32_t maxend;
+    Node(const int32_t s, const int32_t e): start(s), end(e), maxend(e) {}
+  };
+  struct StackItem {
+    int32_t k;
+    int64_t x;
+    int32_t w;
+  };
+
+  std::vector<Node> nodes;
+  std::vector<T> values;
+  std::vector<size_t> addorder;  // index in values of the i-th added interval
+  int32_t maxlevel;
+
+public:
+  IntervalIndex(): maxlevel(-1) {}
+
+  void add(const int32_t start, const int32_t end, const T &value) {
+    nodes.emplace_back(start, end);
+    values.emplace_back(value);
+    maxlevel = -1;
+  }
+
+  void index() {
+    int64_t n(nodes.size());
+    std::vector<size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [this](const size_t a, const size_t b) { return nodes[a].start < nodes[b].start; });
+
+    std::vector<Node> sortednodes;
+    std::vector<T> sortedvalues;
+    sortednodes.reserve(n);
+    sortedvalues.reserve(n);
+    for (auto i: order) {
+      sortednodes.emplace_back(nodes[i]);
+      sortedvalues.emplace_back(std::move(values[i]));
+    }
+    nodes.swap(sortednodes);
+    values.swap(sortedvalues);
+    addorder.assign(n, 0);
+    for (int64_t i=0; i<n; ++i) addorder[order[i]] = i;
+
+    maxlevel = -1;
+    if (!n) return;
+
+    int64_t last_i(0);
+    int32_t last(0);
+    for (int64_t i=0; i<n; i += 2) {
+      last_i = i;
+      last = nodes[i].maxend = nodes[i].end;
+    }
+    int32_t k(1);
+    for (; static_cast<int64_t>(1)<<k <= n; ++k) {
+      int64_t x(static_cast<int64_t>(1)<<(k-1));
+      int64_t i0((x<<1) -1);
+      int64_t step(x<<2);
+      for (int64_t i=i0; i<n; i += step) {
+        int32_t el(nodes[i-x].maxend);
+        int32_t er(i+x < n ? nodes[i+x].maxend : last);
+        nodes[i].maxend = std::max({nodes[i].end, el, er});
+      }
+      last_i = (last_i>>k & 1) ? last_i - x : last_i + x;
+      if (last_i < n && nodes[last_i].maxend > last) last = nodes[last_i].maxend;
+    }
+    maxlevel = k-1;
+  }
+
+  size_t size() const { return values.size(); }
+  bool empty() const { return values.empty(); }
+
+  /* values sorted by start position */
+  const std::vector<T> & getValues() const { return values; }
+  int32_t getStart(const size_t i) const { return nodes[i].start; }
+  int32_t getEnd(const size_t i) const { return nodes[i].end; }
+
+  /* call func(value) for each interval in the order of add() (e.g. the lines of the input file) */
+  template <class Func>
+  void forEachInAddOrder(Func func) const {
+    for (auto i: addorder) func(values[i]);
+  }
+
+  /* call func(i) for each interval i overlapping [qstart, qend], in order of start */
+  template <class Func>
+  void queryIndex(const int32_t qstart, const int32_t qend, Func func) const {
+    if (maxlevel < 0) return;
+
+    int64_t n(nodes.size());
+    StackItem stack[64];
+    int32_t t(0);
+    stack[t++] = {maxlevel, (static_cast<int64_t>(1)<<maxlevel) -1, 0};
+
+    while (t) {
+      StackItem z = stack[--t];
+      if (z.k <= 3) {  // small subtree: linear scan
+        int64_t i0(z.x >> z.k << z.k);
+        int64_t i1(std::min(i0 + (static_cast<int64_t>(1)<<(z.k+1)) -1, n));
+        for (int64_t i=i0; i<i1 && nodes[i].start <= qend; ++i) {
+          if (qstart <= nodes[i].end) func(static_cast<size_t>(i));
+        }
+      } else if (!z.w) {  // visit left child first
+        int64_t y(z.x - (static_cast<int64_t>(1)<<(z.k-1)));
+        z.w = 1;
+        stack[t++] = z;
+        if (y >= n || nodes[y].maxend >= qstart) stack[t++] = {z.k-1, y, 0};
+      } else if (z.x < n && nodes[z.x].start <= qend) {
+        if (qstart <= nodes[z.x].end) func(static_cast<size_t>(z.x));
+        stack[t++] = {z.k-1, z.x + (static_cast<int64_t>(1)<<(z.k-1)), 0};
+      }
+    }
+  }
+
+  /* call func(value) for each interval overlapping [qstart, qend], in order of start */
+  template <class Func>
+  void query(const int32_t qstart, const int32_t qend, Func func) const {
+    queryIndex(qstart, qend, [this, &func](const size_t i) { func(values[i]); });
+  }
+
+  bool isOverlapped(const int32_t qstart, const int32_t qend) const {
+    bool overlapped(false);
+    queryIndex(qstart, qend, [&overlapped](const size_t) { overlapped = true; });
+    return overlapped;
+  }
+
+  /* copies values; use query() for large T */
+  std::vector<T> getOverlap(const int32_t qstart, const int32_t qend) const {
+    std::vector<T> vec;
+    query(qstart, qend, [&vec](const T &x) { vec.emplace_back(x); });
+    return vec;
+  }
+};
+
+#endif /* _INTERVALINDEX_HPP_ */
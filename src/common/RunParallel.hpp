@@ -0,0 +1,41 @@
+/* Copyright(c) Ryuichiro Nakato <rnakato@iam.u-tokyo.ac.jp>
+ * All rights reserved.
+ */
+#ifndef _RUNPARALLEL_HPP_
+#define _RUNPARALLEL_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <boost/thread.hpp>
+
+/* func(0), ..., func(n-1) with numthreads threads (thread t runs t, t+nthreads, ...).
+ * The first exception thrown by func is rethrown after all threads finish. */
+template <class F>
+void runParallel(const int32_t numthreads, const size_t n, F func)
+{
+  int32_t nthreads(std::max(1, std::min(numthreads, static_cast<int32_t>(n))));
+  if (nthreads == 1) {
+    for (size_t i=0; i<n; ++i) func(i);
+    return;
+  }
+
+  std::exception_ptr error;
+  std::mutex mtx;
+  boost::thread_group agroup;
+  for (int32_t t=0; t<nthreads; ++t) {
+    agroup.create_thread([&, t] {
+        try {
+          for (size_t i=t; i<n; i += nthreads) func(i);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(mtx);
+          if (!error) error = std::current_exception();
+        }
+      });
+  }
+  agroup.join_all();
+  if (error) std::rethrow_exception(error);
+}
+
+#endif /* _RUNPARALLEL_HPP_ */
@@ -47,6 +47,8 @@ class WigArray {
   {}
 
   size_t size() const { return array.size(); }
+  // bins within this length around a bin are used by getLocalAverage()
+  static int32_t getLocalAverageLength() { return LENGTH_FOR_LOCALPOISSON; }
   double operator[] (const size_t i) const {
     checki(i);
     return rmGeta(array[i]);
@@ -74,6 +76,39 @@ class WigArray {
     for (auto x: array) sum += x;
     return rmGeta(sum);
   }
+  /* bulk access to bins [s, e]. Sum and max are taken on the fixed-point
+     values so that the loops are vectorized. */
+  double getRangeSum(const size_t s, const size_t e) const {
+    checki(e);
+    int64_t sum(0);
+    for (size_t i=s; i<=e; ++i) sum += array[i];
+    return rmGeta(sum);
+  }
+  double getRangeMax(const size_t s, const size_t e) const {
+    checki(e);
+    int32_t max(array[s]);
+    for (size_t i=s+1; i<=e; ++i) max = std::max(max, array[i]);
+    return rmGeta(max);
+  }
+  void copyRange(const size_t s, const size_t e, double *out) const {
+    checki(e);
+    const double r(1.0/geta);
+    for (size_t i=s; i<=e; ++i) *out++ = array[i] * r;
+  }
+
+  /* array with two adjacent bins merged (mean or max), for zoom levels */
+  WigArray getDownsampled(const bool takemax) const {
+    WigArray a((array.size() +1)/2, 0);
+    a.geta = geta;
+    for (size_t i=0; i<a.array.size(); ++i) {
+      size_t j(i*2);
+      if (j+1 >= array.size()) a.array[i] = array[j];
+      else if (takemax)        a.array[i] = std::max(array[j], array[j+1]);
+      else                     a.array[i] = (static_cast<int64_t>(array[j]) + array[j+1]) / 2;
+    }
+    return a;
+  }
+
   double getMinValue() const {
     int32_t min(*std::min_element(array.begin(), array.end()));
     return rmGeta(min);
@@ -91,6 +126,23 @@ class WigArray {
     ave /= right - left;
     return rmGeta(ave);
   }
+  // getLocalAverage() of all bins, with a sliding window
+  std::vector<double> getLocalAverages(const int32_t binsize) const {
+    int32_t length_bin(LENGTH_FOR_LOCALPOISSON / binsize);
+    int32_t lenhalf(length_bin/2);
+    int32_t n(array.size());
+    std::vector<double> ave(n);
+    int64_t sum(0);
+    int32_t left(0), right(0);
+    for (int32_t i=0; i<n; ++i) {
+      int32_t l(std::max(i-lenhalf, 0));
+      int32_t r(std::min(i+lenhalf, n));
+      while (right < r) sum += array[right++];
+      while (left < l)  sum -= array[left++];
+      ave[i] = rmGeta(sum / (r - l));
+    }
+    return ave;
+  }
   double getPercentile(double per) const {
     int32_t v95(MyStatistics::getPercentile(array, per));
     return rmGeta(v95);
@@ -190,18 +242,38 @@ class WigStats {
     }*/
 };
 
-class WigStatsGenome {
+// WigStats of the chromosomes and the genome for a bin size
+class WigStatsBin {
   int32_t binsize;
+
+public:
+  std::vector<WigStats> chr;
+  WigStats genome;
+
+  WigStatsBin(const int32_t b, const std::vector<SeqStats> &_chr): binsize(b) {
+    for (auto &x: _chr) chr.emplace_back(x.getlen()/binsize +1, binsize);
+    for (auto &x: chr) genome.nbin += x.getnbin();
+  }
+
+  int32_t getbinsize() const { return binsize; }
+  int32_t getWigDistsize() const { return genome.getWigDistsize(); }
+
+  void setWigStats(const int32_t id, const WigArray &array) {
+    chr[id].setWigStats(array);
+    genome.addWigDist(chr[id]);
+  }
+};
+
+class WigStatsGenome {
   int32_t rcenter;
   WigType type;
   bool outputzero;
   bool onlyreadregion;
 
 public:
-  std::vector<WigStats> chr;
-  WigStats genome;
+  std::vector<WigStatsBin> bins;  // for each --binsize, in ascending order
 
-  WigStatsGenome(): binsize(0), rcenter(0), type(WigType::NONE), outputzero(false), onlyreadregion(false) {}
+  WigStatsGenome(): rcenter(0), type(WigType::NONE), outputzero(false), onlyreadregion(false) {}
 
   void setOpts(MyOpt::Opts &allopts) {
     MyOpt::Opts opt("Wigarray", 100);
@@ -210,8 +282,8 @@ public:
        boost::program_options::value<int32_t>()->default_value(3)->notifier(boost::bind(&MyOpt::range<int32_t>, _1, 0, static_cast<int>(WigType::WIGTYPENUM) -2, "--outputformat")),
        "Output format\n   0: compressed wig (.wig.gz)\n   1: uncompressed wig (.wig)\n   2: bedGraph (.bedGraph)\n   3: bigWig (.bw)")
       ("binsize,b",
-       boost::program_options::value<int32_t>()->default_value(100)->notifier(boost::bind(&MyOpt::over<int32_t>, _1, 1, "--binsize")),
-       "bin size")
+       boost::program_options::value<std::string>()->default_value("100"),
+       "bin size (comma-separated for multiple bin sizes, e.g. 100,1000,5000)")
       ("outputzero", "output zero-value bins (default: omitted)")
       ("rcenter",
        boost::program_options::value<int32_t>()->default_value(0)->notifier(boost::bind(&MyOpt::over<int32_t>, _1, 0, "--rcenter")),
@@ -221,32 +293,48 @@ public:
     allopts.add(opt);
   }
   void setValues(const MyOpt::Variables &values, const std::vector<SeqStats> &_chr) {
-    binsize = MyOpt::getVal<int32_t>(values, "binsize");
+    std::string str(MyOpt::getVal<std::string>(values, "binsize"));
+    std::vector<std::string> v;
+    ParseLine(v, str, ',');
+    std::vector<int32_t> vbinsize;
+    for (auto &x: v) {
+      int32_t binsize(0);
+      try {
+        binsize = stoi(x);
+      } catch (const std::exception &e) {
+        PRINTERR_AND_EXIT("invalid value for --binsize: " << str);
+      }
+      if (binsize < 1) PRINTERR_AND_EXIT("--binsize should be >= 1: " << str);
+      vbinsize.emplace_back(binsize);
+    }
+    if (vbinsize.empty()) PRINTERR_AND_EXIT("invalid value for --binsize: " << str);
+    std::sort(vbinsize.begin(), vbinsize.end());
+    vbinsize.erase(std::unique(vbinsize.begin(), vbinsize.end()), vbinsize.end());
+    for (auto binsize: vbinsize) bins.emplace_back(binsize, _chr);
+
     rcenter = MyOpt::getVal<int32_t>(values, "rcenter");
     type    = static_cast<WigType>(MyOpt::getVal<int32_t>(values, "outputformat"));
     outputzero = values.count("outputzero");
     onlyreadregion = values.count("onlyreadregion");
-
-    for (auto &x: _chr) chr.emplace_back(x.getlen()/binsize +1);
-    for (auto &x: chr) genome.nbin += x.getnbin();
   }
   void dump() const {
     std::vector<std::string> strType = {"COMPRESSED WIG", "WIG", "BEDGRAPH", "BIGWIG"};
     std::cout << "Output format: " << strType[static_cast<int32_t>(type)] << std::endl;
-    std::cout << "Binsize: " << binsize << " bp" << std::endl;
+    std::cout << "Binsize:";
+    for (auto &x: bins) std::cout << " " << x.getbinsize();
+    std::cout << " bp" << std::endl;
   }
 
-  int32_t getbinsize() const { return binsize; }
-  int32_t getWigDistsize() const { return genome.getWigDistsize(); }
+  std::vector<int32_t> getvbinsize() const {
+    std::vector<int32_t> vbinsize;
+    for (auto &x: bins) vbinsize.emplace_back(x.getbinsize());
+    return vbinsize;
+  }
   int32_t getrcenter() const { return rcenter; }
   bool isoutputzero() const { return outputzero; }
   bool isonlyreadregion() const { return onlyreadregion; }
   WigType getWigType() const { return type; }
 
-  void setWigStats(const int32_t id, const WigArray &array) {
-    chr[id].setWigStats(array);
-    genome.addWigDist(chr[id]);
-  }
   /*  void estimateZINB(const int32_t id) {
     genome.estimateZINB(chr[id].nb_p, chr[id].nb_n);
    }*/
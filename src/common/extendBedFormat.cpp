@@ -80,6 +80,21 @@ void InteractionSet::setAsHICCUPS(const std::string &lineStr)
   }
 }
 
+void InteractionSet::construct_index()
+{
+  for (size_t i=0; i<vinter.size(); ++i) {
+    const Interaction &x = vinter[i];
+    anchor[x.first.chrid].add(x.first.start,   x.first.end,   2*i);
+    anchor[x.second.chrid].add(x.second.start, x.second.end, 2*i+1);
+    if (x.first.chrid == x.second.chrid) {
+      intrasummit[x.first.chrid].add(x.first.summit,   x.first.summit,  2*i);
+      intrasummit[x.first.chrid].add(x.second.summit, x.second.summit, 2*i+1);
+    }
+  }
+  for (auto &x: anchor)      x.index();
+  for (auto &x: intrasummit) x.index();
+}
+
 void InteractionSet::compare_bed_loop(const std::vector<bed> &bed1,
                                       const std::vector<bed> &bed2,
                                       const bool nobs)
@@ -87,17 +102,20 @@ void InteractionSet::compare_bed_loop(const std::vector<bed> &bed1,
   int32_t aa(0), bb(0), ab(0), an(0), bn(0), nn(0), hit_bed1(0), hit_bed2(0);
 
   for (auto &x: bed1) {
-    if (isoverlap_asBed(x, vinter)) ++hit_bed1;
+    if (isoverlap_asBed(x)) ++hit_bed1;
   }
   for (auto &x: bed2) {
-    if (isoverlap_asBed(x, vinter)) ++hit_bed2;
+    if (isoverlap_asBed(x)) ++hit_bed2;
   }
+
+  BedIndex<bed> index1(construct_BedIndex(bed1));
+  BedIndex<bed> index2(construct_BedIndex(bed2));
   for (auto &x: vinter) {
     int32_t on(0);
-    x.ofirst.peakovrlpd1  = isoverlap_asloop(x.first, bed1);
-    x.ofirst.peakovrlpd2  = isoverlap_asloop(x.first, bed2);
-    x.osecond.peakovrlpd1 = isoverlap_asloop(x.second, bed1);
-    x.osecond.peakovrlpd2 = isoverlap_asloop(x.second, bed2);
+    x.ofirst.peakovrlpd1  = isoverlap_asloop(x.first,  index1);
+    x.ofirst.peakovrlpd2  = isoverlap_asloop(x.first,  index2);
+    x.osecond.peakovrlpd1 = isoverlap_asloop(x.second, index1);
+    x.osecond.peakovrlpd2 = isoverlap_asloop(x.second, index2);
 
     if ((x.ofirst.peakovrlpd1 && x.osecond.peakovrlpd2) || (x.ofirst.peakovrlpd2 && x.osecond.peakovrlpd1)) {
       ++ab;
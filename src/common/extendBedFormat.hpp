@@ -14,26 +14,29 @@
 #include <boost/algorithm/string.hpp>
 #include "../../submodules/SSP/common/inline.hpp"
 #include "../../submodules/SSP/common/util.hpp"
+#include "IntervalIndex.hpp"
+#include "ChrDictionary.hpp"
 
 class bed {
 public:
   std::string chr;
+  int32_t chrid;   // ID in chrdict()
   int32_t start;
   int32_t end;
   int32_t summit;
   std::string name;
 
-  bed(): start(0), end(0), summit(0) {}
+  bed(): chrid(-1), start(0), end(0), summit(0) {}
   virtual ~bed(){}
 
   bed(const std::string &c, const int32_t s, const int32_t e, const int32_t _summit=0):
-    chr(rmchr(c)), start(s), end(e), name("")
+    chr(rmchr(c)), chrid(chrdict().intern(c)), start(s), end(e), name("")
   {
     if (_summit) summit = _summit;
     else summit = (start + end)/2;
   }
 
-  explicit bed(const std::vector<std::string> &s) {
+  explicit bed(const std::vector<std::string> &s): chrid(-1) {
     if(s.size() < 3) {
       std::cerr << "\nWarning: Bed site size < 3." << std::endl;
       return;
@@ -41,6 +44,7 @@ public:
 
     try {
       chr = rmchr(s[0]);
+      chrid = chrdict().intern(s[0]);
       start = stoi(s[1]);
       end = stoi(s[2]);
       summit = (start + end)/2;
@@ -199,18 +203,33 @@ public:
   }
 };
 
+// indexed by chromosome ID
+template <class T>
+using BedIndex = ChrVector<IntervalIndex<T>>;
+
+template <class T>
+BedIndex<T> construct_BedIndex(const std::vector<T> &vbed)
+{
+  BedIndex<T> index;
+  for (auto &x: vbed) index[x.chrid].add(x.start, x.end, x);
+  for (auto &x: index) x.index();
+  return index;
+}
+
 template <class T>
 class vbed {
-  std::vector<T> bed;
+  BedIndex<T> bedchr;
   std::string label;
 
 public:
   vbed(){}
   vbed(const std::vector<T> &v, const std::string &l):
-    bed(v), label(l)
+    bedchr(construct_BedIndex(v)), label(l)
   {}
   const std::string & getlabel() const { return label; }
-  std::vector<T> getvBed() const { return bed; }
+  const IntervalIndex<T> & getBedChr(const int32_t chrid) const {
+    return bedchr.get(chrid);
+  }
 };
 
 
@@ -293,8 +312,13 @@ class InteractionSet {
   double maxval;
   std::string label;
 
+  /* value: 2*(index of vinter) + (0: first, 1: second anchor) */
+  BedIndex<uint32_t> anchor;        // anchor intervals of all interactions
+  BedIndex<uint32_t> intrasummit;   // anchor summits of intra-chromosomal interactions
+
   void setAsMango(const std::string &lineStr);
   void setAsHICCUPS(const std::string &lineStr);
+  void construct_index();
 
 public:
   InteractionSet(const std::string &fileName, const std::string &l, const std::string &tool):
@@ -316,6 +340,7 @@ public:
       if (tool == "mango") setAsMango(lineStr);
       else setAsHICCUPS(lineStr);
     }
+    construct_index();
     //    print();
   }
   const std::vector<Interaction> & getvinter() const { return vinter; }
@@ -327,20 +352,26 @@ public:
     std::cout << "maxval: " << maxval << std::endl;
   }
 
-  bool isoverlap_asloop(const bed &loop, const std::vector<bed> &bed) const {
-    for (auto &b: bed) {
-      if (loop.chr == b.chr && my_overlap(loop.start, loop.end, b.start, b.end)) return true;
-    }
-    return false;
+  /* func(interaction) for each intra-chromosomal interaction on chr
+     having at least one summit in [start, end], in the order of the file */
+  template <class Func>
+  void queryIntra(const int32_t chrid, const int32_t start, const int32_t end, Func func) const {
+    std::vector<uint32_t> vid;
+    intrasummit.get(chrid).query(start, end, [&] (const uint32_t id) {
+        // count once when both summits are in the window
+        if ((id & 1) && start <= vinter[id/2].first.summit && vinter[id/2].first.summit <= end) return;
+        vid.emplace_back(id/2);
+      });
+    std::sort(vid.begin(), vid.end());
+    for (auto id: vid) func(vinter[id]);
   }
 
-  bool isoverlap_asBed(const bed &bed, const std::vector<Interaction> &vinter) const {
-    for (auto &x: vinter) {
-      if ((x.first.chr  == bed.chr && my_overlap(x.first.start,  x.first.end,  bed.start, bed.end)) ||
-          (x.second.chr == bed.chr && my_overlap(x.second.start, x.second.end, bed.start, bed.end)))
-        return true;
-    }
-    return false;
+  bool isoverlap_asloop(const bed &loop, const BedIndex<bed> &bedindex) const {
+    return bedindex.get(loop.chrid).isOverlapped(loop.start, loop.end);
+  }
+
+  bool isoverlap_asBed(const bed &bed) const {
+    return anchor.get(bed.chrid).isOverlapped(bed.start, bed.end);
   }
 
   void compare_bed_loop(const std::vector<bed> &bed1, const std::vector<bed> &bed2, const bool nobs);
@@ -34,6 +34,34 @@ namespace MyStatistics {
 
     return sortarray[(int32_t)(sortarray.size()*per)];
   };
+
+  /* column-wise mean and variance updated row by row (Welford) */
+  class RunningStats {
+    int64_t n;
+    std::vector<double> mean;
+    std::vector<double> m2;
+
+  public:
+    explicit RunningStats(const int32_t ncol=0):
+      n(0), mean(ncol, 0), m2(ncol, 0)
+    {}
+
+    void add(const double *row) {
+      ++n;
+      for (size_t i=0; i<mean.size(); ++i) {
+        double d(row[i] - mean[i]);
+        mean[i] += d / n;
+        m2[i] += d * (row[i] - mean[i]);
+      }
+    }
+
+    int64_t getn() const { return n; }
+    size_t getncol() const { return mean.size(); }
+    double getmean(const size_t i) const { return mean[i]; }
+    double getsd(const size_t i) const { return n > 1 ? sqrt(m2[i] / (n-1)) : 0; }
+    // half width of the 95% confidence interval of the mean
+    double getCI95(const size_t i) const { return n ? 1.96 * getsd(i) / sqrt(n) : 0; }
+  };
 }
 
 #endif /* _STATISTICS_HPP_ */
@@ -1,6 +1,13 @@
 /* Copyright(c)  Ryuichiro Nakato <rnakato@iam.u-tokyo.ac.jp>
  * All rights reserved.
  */
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <boost/algorithm/string.hpp>
 #include "ReadAnnotation.hpp"
 #include "../submodules/SSP/common/inline.hpp"
@@ -27,6 +34,191 @@ namespace {
     else if (name=="16") return "XVI";
     else return name;
   }
+
+  Biotype getBiotype(const std::string &gtype)
+  {
+    if (gtype == "ARS")        return Biotype::ARS;
+    if (gtype == "centromere") return Biotype::CENTROMERE;
+    if (gtype == "teromere")   return Biotype::TELOMERE;
+    if (gtype == "TER")        return Biotype::TER;
+    if (gtype == "rRNA" || gtype == "snoRNA")        return Biotype::RRNA;
+    if (gtype == "LTR" || gtype == "retrotransposon") return Biotype::LTR;
+    if (gtype == "tRNA")       return Biotype::TRNA;
+    if (gtype == "nonsense_mediated_decay"
+        || gtype == "processed_transcript"
+        || gtype == "retained_intron") return Biotype::NOT_DISPLAYED;
+    if (isStr(gtype, "protein_coding")) return Biotype::PROTEIN_CODING;
+    if (isStr(gtype, "noncoding RNA"))  return Biotype::NONCODING_UCSC;
+    if (isStr(gtype, "lincRNA"))        return Biotype::LINCRNA;
+    if (isStr(gtype, "antisense"))      return Biotype::ANTISENSE;
+    if (isStr(gtype, "RNA"))            return Biotype::OTHER_RNA;
+    if (isStr(gtype, "pseudo"))         return Biotype::PSEUDO;
+    if (isStr(gtype, "repeat"))         return Biotype::REPEAT;
+    return Biotype::OTHERS;
+  }
+
+  void setGeneCategory(HashOfGeneDataMap &mp)
+  {
+    for (auto &pair: mp) {
+      for (auto &x: pair.second) {
+        genedata &g = x.second;
+        g.biotype = getBiotype(g.gtype);
+        if (g.strand == "+")      g.gstrand = GeneStrand::PLUS;
+        else if (g.strand == "-") g.gstrand = GeneStrand::MINUS;
+        else                      g.gstrand = GeneStrand::NONE;
+      }
+    }
+  }
+
+  // read-only mmap of a whole file
+  class MappedFile {
+    const char *data;
+    size_t len;
+
+  public:
+    explicit MappedFile(const std::string &fileName): data(nullptr), len(0) {
+      int32_t fd(open(fileName.c_str(), O_RDONLY));
+      if (fd < 0) PRINTERR_AND_EXIT(fileName << " does not exist.");
+      struct stat st;
+      if (!fstat(fd, &st) && st.st_size > 0) {
+        len = st.st_size;
+        void *p(mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0));
+        if (p == MAP_FAILED) PRINTERR_AND_EXIT("cannot read " << fileName);
+        madvise(p, len, MADV_SEQUENTIAL);
+        data = static_cast<const char *>(p);
+      }
+      close(fd);
+    }
+    ~MappedFile() { if (data) munmap(const_cast<char *>(data), len); }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+
+    const char * begin() const { return data; }
+    const char * end() const { return data + len; }
+  };
+
+  // a field of the mapped file (not null-terminated)
+  class Field {
+  public:
+    const char *p;
+    size_t len;
+    Field(): p(nullptr), len(0) {}
+    Field(const char *s, const char *e): p(s), len(e-s) {}
+
+    bool empty() const { return !len; }
+    bool operator==(const char *str) const { return len == strlen(str) && !memcmp(p, str, len); }
+    bool operator==(const Field &f) const { return len == f.len && !memcmp(p, f.p, len); }
+    bool operator!=(const Field &f) const { return !(*this == f); }
+    std::string str() const { return std::string(p, len); }
+    int32_t toInt() const {
+      char *e;
+      long val(strtol(p, &e, 10));
+      if (e == p) PRINTERR_AND_EXIT("invalid number: " << str());
+      return val;
+    }
+  };
+
+  // split [s, e) by delim into at most v.size() fields; returns the number of fields
+  size_t splitFields(const char *s, const char *e, const char delim, std::vector<Field> &v)
+  {
+    size_t n(0);
+    while (n < v.size()) {
+      const char *p(static_cast<const char *>(memchr(s, delim, e-s)));
+      if (!p || n == v.size()-1) p = e;
+      v[n++] = Field(s, p);
+      if (p == e) break;
+      s = p+1;
+    }
+    return n;
+  }
+
+  // attributes of a GTF line: key "value"; key "value"; ...
+  class GtfAttribute {
+  public:
+    Field gname, tname, gid, tid, gsrc, gtype, tsrc, ttype, ttag;
+
+    void parse(const char *s, const char *e) {
+      while (s < e) {
+        const char *t(static_cast<const char *>(memchr(s, ';', e-s)));
+        if (!t) t = e;
+        const char *q1(static_cast<const char *>(memchr(s, '"', t-s)));
+        const char *q2(q1 ? static_cast<const char *>(memchr(q1+1, '"', t-q1-1)) : nullptr);
+        if (q2) {
+          while (s < q1 && *s == ' ') ++s;
+          const char *k(s);
+          while (k < q1 && *k != ' ') ++k;
+          Field key(s, k), val(q1+1, q2);
+          if (key == "gene_source")             gsrc  = val;
+          else if (key == "gene_biotype")       gtype = val;
+          else if (key == "transcript_source")  tsrc  = val;
+          else if (key == "transcript_biotype") ttype = val;
+          else if (key == "transcript_name")    tname = val;
+          else if (key == "gene_name")          gname = val;
+          else if (key == "transcript_id")      tid   = val;
+          else if (key == "gene_id")            gid   = val;
+          else if (key == "tag") {
+            if (ttag.empty() || val == "CCDS")           ttag = val;
+            else if (val == "basic" && !(ttag == "CCDS")) ttag = val;
+            else if (!(ttag == "basic") && !(ttag == "CCDS")) ttag = val;
+          }
+        }
+        s = t+1;
+      }
+    }
+  };
+
+  template <class T>
+  void writeVal(std::ofstream &out, const T &val)
+  {
+    out.write(reinterpret_cast<const char *>(&val), sizeof(T));
+  }
+  void writeStr(std::ofstream &out, const std::string &str)
+  {
+    writeVal<uint32_t>(out, str.size());
+    out.write(str.data(), str.size());
+  }
+  template <class T>
+  T readVal(std::ifstream &in)
+  {
+    T val(0);
+    in.read(reinterpret_cast<char *>(&val), sizeof(T));
+    return val;
+  }
+  std::string readStr(std::ifstream &in)
+  {
+    std::string str(readVal<uint32_t>(in), '\0');
+    in.read(&str[0], str.size());
+    return str;
+  }
+
+  const char GENECACHE_MAGIC[] = "DGENE";
+  const uint32_t GENECACHE_VERSION(2);
+
+  // "" if the file does not exist
+  std::string getCanonicalPath(const std::string &file)
+  {
+    char buf[PATH_MAX];
+    if (!realpath(file.c_str(), buf)) return "";
+    return buf;
+  }
+
+  // the cache is valid for the same format, path, size and mtime of the source file
+  bool isGeneCacheHeader(std::ifstream &in, const std::string &genefile, const int32_t gftype)
+  {
+    struct stat st;
+    if (stat(genefile.c_str(), &st)) return false;
+    std::string path(getCanonicalPath(genefile));
+    if (path == "") return false;
+    char magic[sizeof(GENECACHE_MAGIC)];
+    in.read(magic, sizeof(magic));
+    return in && !memcmp(magic, GENECACHE_MAGIC, sizeof(magic))
+      && readVal<uint32_t>(in) == GENECACHE_VERSION
+      && readVal<int32_t>(in)  == gftype
+      && readStr(in) == path
+      && readVal<int64_t>(in)  == static_cast<int64_t>(st.st_size)
+      && readVal<int64_t>(in)  == static_cast<int64_t>(st.st_mtime)
+      && in;
+  }
 }
 
 int32_t countmp(HashOfGeneDataMap &mp)
@@ -110,6 +302,7 @@ void parseARSOriDB(const std::string& fileName, HashOfGeneDataMap &mp)
     mp[chr][tname].txEnd   = stoi(v[6]);
     mp[chr][tname].gtype   = "ARS";
   }
+  setGeneCategory(mp);
   return;
 }
 
@@ -137,6 +330,7 @@ void parseTER(const std::string& fileName, HashOfGeneDataMap &mp)
     mp[chr][tname].txEnd   = stoi(v[3]);
     mp[chr][tname].gtype   = "TER";
   }
+  setGeneCategory(mp);
   return;
 }
 
@@ -194,6 +388,7 @@ HashOfGeneDataMap parseSGD(const std::string& fileName)
     }
     if (type == "ARS" || type == "centromere"|| type == "teromere") tmp[chr][tname].strand = "";
   }
+  setGeneCategory(tmp);
   return tmp;
 }
 
@@ -248,6 +443,7 @@ HashOfGeneDataMap parseRefFlat(const std::string& fileName)
       PRINTERR_AND_EXIT("invalid columns in refFlat format. " + std::string(e.what()));
     }
   }
+  setGeneCategory(tmp);
   return tmp;
 }
 
@@ -257,73 +453,72 @@ HashOfGeneDataMap parseGtf(const std::string& fileName)
     std::cerr << "Warning: gene file may not be gtf format but is parsed as gtf." << std::endl;
   }
 
-  std::ifstream in(fileName);
-  if (!in) PRINTERR_AND_EXIT("gtf file does not exist.");
-
+  MappedFile file(fileName);
   HashOfGeneDataMap tmp;
-  std::string lineStr;
 
-  while (!in.eof()) {
-    getline(in, lineStr);
-    if (lineStr.empty() || lineStr[0] == '#') continue;
-    std::vector<std::string> v;
-
-    boost::split(v, lineStr, boost::algorithm::is_any_of("\t"));
-    std::string feat(v[2]);
+  std::vector<Field> v(9);
+  GtfAttribute attr;
+  // lines of a transcript are usually contiguous, so the last chromosome and transcript are kept
+  Field lastchr, lasttid;
+  GeneDataMap *chrmap(nullptr);
+  genedata *g(nullptr);
+  std::string chr;
+
+  for (const char *s = file.begin(); s < file.end(); ) {
+    const char *e(static_cast<const char *>(memchr(s, '\n', file.end() - s)));
+    if (!e) e = file.end();
+    const char *next(e+1);
+    if (e > s && e[-1] == '\r') --e;
+    if (e == s || *s == '#' || splitFields(s, e, '\t', v) < 9) { s = next; continue; }
+    s = next;
+
+    const Field &feat(v[2]);
     if (feat == "gene" || feat == "transcript" || feat == "three_prime_utr" || feat == "five_prime_utr") continue;
 
-    std::string chr(rmchr(v[0]));
-    int32_t start(stoi(v[3]));
-    int32_t end(stoi(v[4]));
-    std::string strand(v[6]);
-    std::string annotation(v[8]);
-
-    std::string gname, tname, gid, tid, gsrc, gtype, tsrc, ttype, ttag="";
-    std::vector<std::string> idtab, vc;
-    boost::split(idtab, annotation, boost::algorithm::is_any_of(";"));
-    for (auto &term: idtab) {
-      boost::split(vc, term, boost::algorithm::is_any_of("\""));
-      if (isStr(vc[0], "gene_source"))             gsrc  = vc[1];
-      else if (isStr(vc[0], "gene_biotype"))       gtype = vc[1];
-      else if (isStr(vc[0], "transcript_source"))  tsrc  = vc[1];
-      else if (isStr(vc[0], "transcript_biotype")) ttype = vc[1];
-      else if (isStr(vc[0], "transcript_name")) tname = vc[1];
-      else if (isStr(vc[0], "gene_name"))       gname = vc[1];
-      else if (isStr(vc[0], "transcript_id"))   tid = vc[1];
-      else if (isStr(vc[0], "gene_id"))         gid = vc[1];
-      else if (isStr(vc[0], "tag")) {
-        if (ttag=="" || vc[1]=="CCDS")           ttag = vc[1];
-        else if (vc[1] == "basic" && ttag != "CCDS") ttag = vc[1];
-        else if (ttag  != "basic" && ttag != "CCDS") ttag = vc[1];
+    attr = GtfAttribute();
+    attr.parse(v[8].p, v[8].p + v[8].len);
+    if (attr.tname.empty()) continue;
+
+    if (!chrmap || v[0] != lastchr) {
+      chr = rmchr(v[0].str());
+      chrmap = &tmp[chr];
+      lastchr = v[0];
+      g = nullptr;
+    }
+    if (!g || attr.tid != lasttid) {
+      g = &(*chrmap)[attr.tid.str()];
+      lasttid = attr.tid;
+      if (g->tid.empty()) {
+        g->tid = attr.tid.str();
+        g->chr = chr;
       }
     }
-
-    if (tname =="") continue;
-
-    tmp[chr][tid].tname  = tname;
-    tmp[chr][tid].gname  = gname;
-    tmp[chr][tid].tid    = tid;
-    tmp[chr][tid].gid    = gid;
-    tmp[chr][tid].chr    = chr;
-    tmp[chr][tid].strand = strand;
+    // as the other fields, the names, strand, tag and sources are those of the last line of the transcript
+    g->tname  = attr.tname.str();
+    g->gname  = attr.gname.str();
+    g->gid    = attr.gid.str();
+    g->strand = v[6].str();
+    g->gsrc   = attr.gsrc.str();
+    g->tsrc   = attr.tsrc.str();
+    g->gtype  = attr.gtype.str();
+    g->ttype  = attr.ttype.str();
+    g->ttag   = attr.ttag.str();
+
+    int32_t start(v[3].toInt());
+    int32_t end(v[4].toInt());
+    bool plus(v[6] == "+");
     if (feat == "start_codon") {
-      if (strand == "+") tmp[chr][tid].cdsStart = start;
-      else tmp[chr][tid].cdsEnd = end;
+      if (plus) g->cdsStart = start;
+      else g->cdsEnd = end;
     } else if (feat == "stop_codon") {
-      if (strand == "+") tmp[chr][tid].cdsEnd = end;
-      else tmp[chr][tid].cdsStart = start;
+      if (plus) g->cdsEnd = end;
+      else g->cdsStart = start;
     } else if (feat == "exon") {
-      ++tmp[chr][tid].exonCount;
-      if (!tmp[chr][tid].txStart || start < tmp[chr][tid].txStart) tmp[chr][tid].txStart = start;
-      if (end > tmp[chr][tid].txEnd) tmp[chr][tid].txEnd = end;
-      tmp[chr][tid].exon.emplace_back(start, end);
+      ++g->exonCount;
+      if (!g->txStart || start < g->txStart) g->txStart = start;
+      if (end > g->txEnd) g->txEnd = end;
+      g->exon.emplace_back(start, end);
     }
-
-    tmp[chr][tid].gsrc = gsrc;
-    tmp[chr][tid].tsrc = tsrc;
-    tmp[chr][tid].gtype = gtype;
-    tmp[chr][tid].ttype = ttype;
-    tmp[chr][tid].ttag = ttag;
   }
 
   // "start_codon", "stop_codon"がないとcdsStart, cdsEndが0になる
@@ -334,9 +529,89 @@ HashOfGeneDataMap parseGtf(const std::string& fileName)
     }
   }
 
+  setGeneCategory(tmp);
   return tmp;
 }
 
+bool loadGeneCache(const std::string &cachefile, const std::string &genefile, const int32_t gftype, HashOfGeneDataMap &mp)
+{
+  std::ifstream in(cachefile, std::ios::binary);
+  if (!in || !isGeneCacheHeader(in, genefile, gftype)) return false;
+
+  HashOfGeneDataMap tmp;
+  uint64_t nchr(readVal<uint64_t>(in));
+  for (uint64_t i=0; i<nchr && in; ++i) {
+    GeneDataMap &chrmap = tmp[readStr(in)];
+    uint64_t ngene(readVal<uint64_t>(in));
+    chrmap.reserve(ngene);
+    for (uint64_t j=0; j<ngene && in; ++j) {
+      genedata &g = chrmap[readStr(in)];
+      for (auto str: {&g.tname, &g.gname, &g.tid, &g.gid, &g.chr, &g.strand,
+            &g.gsrc, &g.tsrc, &g.gtype, &g.ttype, &g.ttag}) *str = readStr(in);
+      for (auto val: {&g.txStart, &g.txEnd, &g.cdsStart, &g.cdsEnd, &g.exonCount}) *val = readVal<int32_t>(in);
+      uint32_t nexon(readVal<uint32_t>(in));
+      g.exon.reserve(nexon);
+      for (uint32_t k=0; k<nexon; ++k) {
+        int32_t start(readVal<int32_t>(in));
+        g.exon.emplace_back(start, readVal<int32_t>(in));
+      }
+    }
+  }
+  if (!in) return false;
+
+  setGeneCategory(tmp);
+  mp.swap(tmp);
+  return true;
+}
+
+// written to a temporary file and renamed; the directory is created if needed, and nothing is written if it is not writable
+void saveGeneCache(const std::string &cachefile, const std::string &genefile, const int32_t gftype, const HashOfGeneDataMap &mp)
+{
+  struct stat st;
+  if (stat(genefile.c_str(), &st)) return;
+  std::string path(getCanonicalPath(genefile));
+  if (path == "") return;
+
+  size_t slash(cachefile.rfind('/'));
+  if (slash != std::string::npos && slash) mkdir(cachefile.substr(0, slash).c_str(), 0755);
+
+  std::string tmpfile(cachefile + ".tmp" + std::to_string(getpid()));
+  {
+    std::ofstream out(tmpfile, std::ios::binary);
+    if (!out) return;
+
+    out.write(GENECACHE_MAGIC, sizeof(GENECACHE_MAGIC));
+    writeVal<uint32_t>(out, GENECACHE_VERSION);
+    writeVal<int32_t>(out, gftype);
+    writeStr(out, path);
+    writeVal<int64_t>(out, st.st_size);
+    writeVal<int64_t>(out, st.st_mtime);
+
+    writeVal<uint64_t>(out, mp.size());
+    for (auto &pair: mp) {
+      writeStr(out, pair.first);
+      writeVal<uint64_t>(out, pair.second.size());
+      for (auto &x: pair.second) {
+        const genedata &g = x.second;
+        writeStr(out, x.first);
+        for (auto str: {&g.tname, &g.gname, &g.tid, &g.gid, &g.chr, &g.strand,
+              &g.gsrc, &g.tsrc, &g.gtype, &g.ttype, &g.ttag}) writeStr(out, *str);
+        for (auto val: {g.txStart, g.txEnd, g.cdsStart, g.cdsEnd, g.exonCount}) writeVal<int32_t>(out, val);
+        writeVal<uint32_t>(out, g.exon.size());
+        for (auto &ex: g.exon) {
+          writeVal<int32_t>(out, ex.start);
+          writeVal<int32_t>(out, ex.end);
+        }
+      }
+    }
+    if (!out) {
+      unlink(tmpfile.c_str());
+      return;
+    }
+  }
+  if (rename(tmpfile.c_str(), cachefile.c_str())) unlink(tmpfile.c_str());
+}
+
 HashOfGeneDataMap construct_gmp(const HashOfGeneDataMap &tmp)
 {
   HashOfGeneDataMap gmp;
@@ -366,6 +641,26 @@ HashOfGeneDataMap construct_gmp(const HashOfGeneDataMap &tmp)
   return gmp;
 }
 
+bool isNotDisplayedTranscript(const genedata &m)
+{
+  return m.biotype == Biotype::NOT_DISPLAYED;
+}
+
+// index holds pointers to mp, so mp must not be modified afterward
+ChrGeneIndex construct_GeneIndex(const HashOfGeneDataMap &mp)
+{
+  ChrGeneIndex index;
+  for (auto &pair: mp) {
+    GeneIndex &gindex = index[chrdict().intern(pair.first)];
+    for (auto &x: pair.second) {
+      if (isNotDisplayedTranscript(x.second)) continue;
+      gindex.add(x.second.txStart, x.second.txEnd, &x.second);
+    }
+    gindex.index();
+  }
+  return index;
+}
+
 void printMap(const HashOfGeneDataMap &mp)
 {
   for (auto &pair: mp) {
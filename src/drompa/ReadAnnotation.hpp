@@ -7,9 +7,13 @@
 #include <unordered_map>
 #include <boost/algorithm/string.hpp>
 #include "../common/GeneAnnotation.hpp"
+#include "../common/IntervalIndex.hpp"
+#include "../common/ChrDictionary.hpp"
 
 using GeneDataMap = std::unordered_map<std::string, genedata>;
 using HashOfGeneDataMap = std::unordered_map<std::string, GeneDataMap>;
+using GeneIndex = IntervalIndex<const genedata *>;
+using ChrGeneIndex = ChrVector<GeneIndex>;
 
 int32_t countmp(HashOfGeneDataMap &);
 std::vector<std::string> scanGeneName(const HashOfGeneDataMap &);
@@ -20,7 +24,11 @@ void parseTER(const std::string& fileName, HashOfGeneDataMap &mp);
 HashOfGeneDataMap parseSGD(const std::string&);
 HashOfGeneDataMap parseRefFlat(const std::string&);
 HashOfGeneDataMap parseGtf(const std::string&);
+bool loadGeneCache(const std::string &cachefile, const std::string &genefile, const int32_t gftype, HashOfGeneDataMap &);
+void saveGeneCache(const std::string &cachefile, const std::string &genefile, const int32_t gftype, const HashOfGeneDataMap &);
 HashOfGeneDataMap construct_gmp(const HashOfGeneDataMap &);
+bool isNotDisplayedTranscript(const genedata &);
+ChrGeneIndex construct_GeneIndex(const HashOfGeneDataMap &);
 void printMap(const HashOfGeneDataMap &);
 bool isGeneUCSC(const HashOfGeneDataMap &);
 void printRefFlat(const HashOfGeneDataMap &, const int32_t nameflag);
@@ -0,0 +1,212 @@
+/* Copyright(c) Ryuichiro Nakato <rnakato@iam.u-tokyo.ac.jp>
+ * All rights reserved.
+ */
+#include <fstream>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include <stdexcept>
+#include <zlib.h>
+#include "dd_bigwig.hpp"
+
+/* bbiFile format of the UCSC kent source (bbiFile.h, bPlusTree.h, cirTree.h, bwgInternal.h) */
+namespace {
+  const uint32_t BIGWIG_MAGIC(0x888FFC26);
+  const uint32_t BPT_MAGIC(0x78CA8C91);
+  const uint32_t CIRTREE_MAGIC(0x2468ACE0);
+
+  using Regions = std::vector<std::pair<int32_t, int32_t>>;
+
+  class BigWigFile {
+    std::string filename;
+    std::ifstream in;
+    bool swap;
+
+  public:
+    uint64_t chromTreeOffset;
+    uint64_t fullIndexOffset;
+    uint32_t uncompressBufSize;
+
+    explicit BigWigFile(const std::string &f):
+      filename(f), in(f, std::ios::binary), swap(false)
+    {
+      if (!in) throw std::runtime_error("cannot open " + filename);
+      std::string header(readAt(0, 64));
+      uint32_t magic(get<uint32_t>(header, 0));
+      if (magic != BIGWIG_MAGIC) {
+        swap = true;
+        if (get<uint32_t>(header, 0) != BIGWIG_MAGIC) throw std::runtime_error(filename + " is not a bigWig file.");
+      }
+      chromTreeOffset   = get<uint64_t>(header, 8);
+      fullIndexOffset   = get<uint64_t>(header, 24);
+      uncompressBufSize = get<uint32_t>(header, 52);
+    }
+
+    void error(const std::string &msg) const {
+      throw std::runtime_error(filename + ": " + msg);
+    }
+
+    std::string readAt(const uint64_t offset, const uint64_t size) {
+      std::string buf(size, '\0');
+      in.seekg(offset);
+      if (!in.read(&buf[0], size)) error("unexpected end of file.");
+      return buf;
+    }
+
+    template <class T>
+    T get(const std::string &buf, const size_t pos) const {
+      if (pos + sizeof(T) > buf.size()) error("broken data.");
+      T val;
+      if (swap) {
+        char tmp[sizeof(T)];
+        std::reverse_copy(&buf[pos], &buf[pos] + sizeof(T), tmp);
+        memcpy(&val, tmp, sizeof(T));
+      } else memcpy(&val, &buf[pos], sizeof(T));
+      return val;
+    }
+
+    // -1 if not found
+    int64_t findChrom(const std::string &chrname) {
+      std::string header(readAt(chromTreeOffset, 32));
+      if (get<uint32_t>(header, 0) != BPT_MAGIC) error("invalid chromosome tree.");
+      uint32_t keySize(get<uint32_t>(header, 8));
+      uint32_t valSize(get<uint32_t>(header, 12));
+      if (chrname.size() > keySize || valSize < 8) return -1;
+      std::string key(chrname);
+      key.resize(keySize, '\0');
+
+      uint64_t offset(chromTreeOffset + 32);
+      while (1) {
+        std::string node(readAt(offset, 4));
+        bool isLeaf(node[0]);
+        uint16_t count(get<uint16_t>(node, 2));
+        size_t itemsize(keySize + (isLeaf ? valSize : 8));
+        std::string items(readAt(offset + 4, count * itemsize));
+        if (isLeaf) {
+          for (uint16_t i=0; i<count; ++i) {
+            if (!items.compare(i*itemsize, keySize, key)) return get<uint32_t>(items, i*itemsize + keySize);
+          }
+          return -1;
+        }
+        // the last child whose first key is not larger than the name
+        if (!count) return -1;
+        uint16_t child(0);
+        for (uint16_t i=1; i<count; ++i) {
+          if (items.compare(i*itemsize, keySize, key) > 0) break;
+          child = i;
+        }
+        offset = get<uint64_t>(items, child*itemsize + keySize);
+      }
+    }
+
+    // (offset, size) of the leaf blocks of chromId overlapping the regions
+    void findBlocks(const uint64_t offset, const uint32_t chromId, const Regions &regions,
+                    std::vector<std::pair<uint64_t, uint64_t>> &blocks, const int32_t depth=0) {
+      if (depth > 64) error("invalid index.");
+      std::string node(readAt(offset, 4));
+      bool isLeaf(node[0]);
+      uint16_t count(get<uint16_t>(node, 2));
+      size_t itemsize(isLeaf ? 32 : 24);
+      std::string items(readAt(offset + 4, count * itemsize));
+
+      for (uint16_t i=0; i<count; ++i) {
+        size_t p(i * itemsize);
+        uint32_t startChrom(get<uint32_t>(items, p)), startBase(get<uint32_t>(items, p+4));
+        uint32_t endChrom(get<uint32_t>(items, p+8)),  endBase(get<uint32_t>(items, p+12));
+        if (startChrom > chromId || endChrom < chromId) continue;
+        int64_t s(startChrom < chromId ? 0 : startBase);
+        int64_t e(endChrom > chromId ? std::numeric_limits<int64_t>::max() : endBase);
+
+        // the first region ending after s
+        auto itr = std::upper_bound(regions.begin(), regions.end(), s,
+                                    [] (const int64_t x, const std::pair<int32_t, int32_t> &r) { return x < r.second; });
+        if (itr == regions.end() || itr->first >= e) continue;
+
+        if (isLeaf) blocks.emplace_back(get<uint64_t>(items, p+16), get<uint64_t>(items, p+24));
+        else findBlocks(get<uint64_t>(items, p+16), chromId, regions, blocks, depth+1);
+      }
+    }
+
+    std::string uncompressBlock(const std::string &data) const {
+      if (!uncompressBufSize) return data;
+      std::string buf(uncompressBufSize, '\0');
+      uLongf len(uncompressBufSize);
+      if (uncompress(reinterpret_cast<Bytef *>(&buf[0]), &len,
+                     reinterpret_cast<const Bytef *>(data.data()), data.size()) != Z_OK) {
+        error("broken compressed block.");
+      }
+      buf.resize(len);
+      return buf;
+    }
+
+    void parseBlock(const std::string &data, const uint32_t chromId,
+                    const std::function<void(int32_t, int32_t, float)> &func) const {
+      size_t p(0);
+      while (p + 24 <= data.size()) {
+        uint32_t chrom(get<uint32_t>(data, p));
+        int32_t chromStart(get<uint32_t>(data, p+4));
+        uint32_t itemStep(get<uint32_t>(data, p+12));
+        uint32_t itemSpan(get<uint32_t>(data, p+16));
+        uint8_t type(data[p+20]);
+        uint16_t count(get<uint16_t>(data, p+22));
+        p += 24;
+
+        size_t itemsize(type == 1 ? 12 : type == 2 ? 8 : type == 3 ? 4 : 0);
+        if (!itemsize) error("unknown section type " + std::to_string(type) + ".");
+        if (p + count * itemsize > data.size()) error("broken section.");
+        if (chrom == chromId) {
+          for (uint16_t i=0; i<count; ++i, p += itemsize) {
+            if (type == 1)      func(get<uint32_t>(data, p), get<uint32_t>(data, p+4), get<float>(data, p+8));
+            else if (type == 2) {
+              int32_t start(get<uint32_t>(data, p));
+              func(start, start + itemSpan, get<float>(data, p+4));
+            } else {
+              int32_t start(chromStart + i * itemStep);
+              func(start, start + itemSpan, get<float>(data, p));
+            }
+          }
+        } else p += count * itemsize;
+      }
+    }
+  };
+}
+
+void readBigWig(const std::string &filename, const std::string &chrname,
+                const std::vector<std::pair<int32_t, int32_t>> &regions,
+                const std::function<void(int32_t, int32_t, float)> &func)
+{
+  BigWigFile bw(filename);
+  int64_t chromId(bw.findChrom(chrname));
+  if (chromId < 0) return;
+
+  // sorted and disjoint, so that the ends are also sorted
+  Regions sorted;
+  if (regions.empty()) sorted.emplace_back(0, std::numeric_limits<int32_t>::max());
+  else {
+    Regions tmp(regions);
+    std::sort(tmp.begin(), tmp.end());
+    for (auto &x: tmp) {
+      if (!sorted.empty() && x.first <= sorted.back().second) sorted.back().second = std::max(sorted.back().second, x.second);
+      else sorted.emplace_back(x);
+    }
+  }
+
+  std::string header(bw.readAt(bw.fullIndexOffset, 48));
+  if (bw.get<uint32_t>(header, 0) != CIRTREE_MAGIC) bw.error("invalid index.");
+
+  std::vector<std::pair<uint64_t, uint64_t>> blocks;
+  bw.findBlocks(bw.fullIndexOffset + 48, chromId, sorted, blocks);
+  std::sort(blocks.begin(), blocks.end());
+  blocks.erase(std::unique(blocks.begin(), blocks.end()), blocks.end());
+
+  // adjacent blocks are read at once
+  for (size_t i=0; i<blocks.size(); ) {
+    size_t j(i+1);
+    uint64_t end(blocks[i].first + blocks[i].second);
+    while (j < blocks.size() && blocks[j].first == end) end += blocks[j++].second;
+
+    uint64_t base(blocks[i].first);
+    std::string data(bw.readAt(base, end - base));
+    for (; i<j; ++i) bw.parseBlock(bw.uncompressBlock(data.substr(blocks[i].first - base, blocks[i].second)), chromId, func);
+  }
+}
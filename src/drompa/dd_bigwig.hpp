@@ -0,0 +1,23 @@
+/* Copyright(c) Ryuichiro Nakato <rnakato@iam.u-tokyo.ac.jp>
+ * All rights reserved.
+ */
+#ifndef _DD_BIGWIG_H_
+#define _DD_BIGWIG_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/* Reads the full-resolution data of one chromosome of a bigWig file in-process.
+ * The R-tree index is traversed once for all regions, and each data block overlapping them
+ * is read and decompressed once (adjacent blocks in one read).
+ * regions: [start, end) in bp; the whole chromosome if empty.
+ * func(start, end, value) is called for each item ([start, end), 0-based) of the chromosome
+ * in these blocks, so items near the regions are also given.
+ * Nothing is read if the chromosome is not in the file. Errors are thrown as std::runtime_error. */
+void readBigWig(const std::string &filename, const std::string &chrname,
+                const std::vector<std::pair<int32_t, int32_t>> &regions,
+                const std::function<void(int32_t, int32_t, float)> &func);
+
+#endif /* _DD_BIGWIG_H_ */
@@ -0,0 +1,59 @@
+/* Copyright(c) Ryuichiro Nakato <rnakato@iam.u-tokyo.ac.jp>
+ * All rights reserved.
+ */
+#ifndef _DD_CHIADROP_H_
+#define _DD_CHIADROP_H_
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include "IntervalIndex.hpp"
+
+/* ChIA-Drop fragments of a chromosome.
+ * Barcodes are split at gaps longer than --chia_distance_thre, fragments with one read are dropped
+ * and identical fragments are collapsed into one entry with the barcodes they come from.
+ * Positions are stored flat: fragment i has posi[offset[i]] .. posi[offset[i+1]-1]
+ * and its barcodes span [first, last] of barcode[boffset[i]] .. barcode[boffset[i+1]-1] on the chromosome. */
+class ChIADropFragments {
+  std::vector<uint32_t> offset;
+  std::vector<int32_t> posi;
+  std::vector<uint32_t> boffset;
+  std::vector<std::pair<int32_t, int32_t>> barcode;
+  IntervalIndex<uint32_t> fragindex;  // fragment id by [first, last]
+
+public:
+  ChIADropFragments(): offset(1, 0), boffset(1, 0) {}
+
+  // add fragments in the order of positions and call index()
+  void add(const std::vector<int32_t> &v, const std::vector<std::pair<int32_t, int32_t>> &vbarcode) {
+    fragindex.add(v.front(), v.back(), size());
+    posi.insert(posi.end(), v.begin(), v.end());
+    offset.emplace_back(posi.size());
+    barcode.insert(barcode.end(), vbarcode.begin(), vbarcode.end());
+    boffset.emplace_back(barcode.size());
+  }
+  void index() { fragindex.index(); }
+
+  size_t size() const { return offset.size() -1; }
+  const int32_t * begin(const uint32_t i) const { return posi.data() + offset[i]; }
+  const int32_t * end(const uint32_t i) const { return posi.data() + offset[i+1]; }
+  int32_t first(const uint32_t i) const { return posi[offset[i]]; }
+  int32_t last(const uint32_t i) const { return posi[offset[i+1] -1]; }
+
+  // the number of barcodes of fragment i that do not span the whole of [start, end]
+  int32_t getCount(const uint32_t i, const int32_t start, const int32_t end) const {
+    int32_t n(0);
+    for (uint32_t j=boffset[i]; j<boffset[i+1]; ++j) {
+      if (!(barcode[j].first < start && barcode[j].second > end)) ++n;
+    }
+    return n;
+  }
+
+  // func(id) for each fragment overlapping [start, end]
+  template <class Func>
+  void query(const int32_t start, const int32_t end, Func func) const {
+    fragindex.query(start, end, func);
+  }
+};
+
+#endif /* _DD_CHIADROP_H_ */
@@ -68,6 +68,13 @@ std::vector<Command> generateCommands()
 			    CommandParamSet(5, 0, 0, 0, 0, 0,
 					    0, 0, 0, 0)
 			    ));
+  cmds.emplace_back(Command("SERVE", "Keep samples and annotations loaded and draw regions on request",
+			    "-i <ChIP>,<Input>,<label> [-i <ChIP>,<Input>,<label> ...]",
+			    exec_SERVE,
+			    {DrompaCommand::CHIP, DrompaCommand::NORM, DrompaCommand::THRE, DrompaCommand::ANNO_PC, DrompaCommand::ANNO_GV, DrompaCommand::DRAW, DrompaCommand::SERVE, DrompaCommand::OTHER},
+			    CommandParamSet(5, 1, 0, 30, 3, 5,
+					    5, 4, 0, 0)
+			    ));
 /*  cmds.emplace_back(Command("CI", "compare peak-intensity between two samples",
 			    "-i <ChIP>,,<label> -i <ChIP>,,<label> -bed <bedfile>",
 			    exec_PCSHARP,
@@ -115,6 +122,10 @@ void Command::InitDump()
 	DEBUGprint("INITDUMP:DrompaCommand::GENWIG");
 	std::cout << boost::format("Output format %1%\n")
 	  % p.genwig_getOutputFileTypeStr();
+	std::cout << boost::format("Output value %1%\n")
+	  % p.genwig_getOutputValueStr();
+	std::cout << boost::format("Number of threads %1%\n")
+	  % p.getNumThreads();
 	break;
       }
     case DrompaCommand::CG:
@@ -130,6 +141,13 @@ void Command::InitDump()
 	break;
       }
     case DrompaCommand::PROF: p.prof.InitDump(); break;
+    case DrompaCommand::SERVE:
+      {
+	if (p.getSocketPath() != "") std::cout << boost::format("Socket: %1%\n") % p.getSocketPath();
+	else std::cout << boost::format("Requests: stdin\n");
+	std::cout << boost::format("Chromosomes kept loaded: %1%\n") % p.getMaxChr();
+	break;
+      }
     case DrompaCommand::OTHER: p.InitDumpOther(); break;
     }
   }
@@ -14,6 +14,7 @@ void exec_GV(DROMPA::Global &p);
 void exec_PROFILE(DROMPA::Global &p);
 void exec_MULTICI(DROMPA::Global &p);
 void exec_GENWIG(DROMPA::Global &p);
+void exec_SERVE(DROMPA::Global &p);
 
 class Command {
   std::string name;
@@ -3,11 +3,15 @@
  */
 
 #include <sstream>
+#include <algorithm>
+#include <stdexcept>
 #include <iomanip>
 #include "dd_draw.hpp"
 #include "dd_draw_pdfpage.hpp"
 #include "dd_draw_dataframe.hpp"
+#include "dd_outputcache.hpp"
 #include "color.hpp"
+#include "RunParallel.hpp"
 #include "../submodules/SSP/common/inline.hpp"
 #include "../submodules/SSP/common/util.hpp"
 
@@ -81,6 +85,151 @@ namespace {
     }
     return;
   }
+
+  std::string getPageTitle(const std::string &chrname, const std::string &pagelabel,
+                           const int32_t page_no, const int32_t num_page)
+  {
+    std::string title(chrname);
+    if (pagelabel != "None") title += "_" + pagelabel;
+    if (num_page>1) title += "_" + std::to_string(page_no+1);
+    return title;
+  }
+
+  class PageJob {
+  public:
+    int32_t start;
+    int32_t end;
+    int32_t page_no;
+    std::string label;
+    std::string progress;
+    bool lastpage;  // last page of the region
+    int32_t num_page;
+
+    PageJob(const int32_t s, const int32_t e, const int32_t n,
+            const std::string &l, const std::string &prog, const int32_t num):
+      start(s), end(e), page_no(n), label(l), progress(prog), lastpage(n == num-1), num_page(num)
+    {}
+
+    void printProgress() const {
+      std::cout << progress << std::flush;
+      if (lastpage) printf("\n");
+    }
+  };
+
+  // render jobs[i] to vpng[i] in parallel
+  void drawPngFiles(const DROMPA::Global &p,
+                    const vChrArray &vReadArray,
+                    const std::vector<SamplePairOverlayed> &pairs,
+                    const GraphTracks &graphs,
+                    const int32_t width, const int32_t height,
+                    const std::vector<PageJob> &jobs,
+                    const std::vector<std::string> &vpng)
+  {
+    vReadArray.prepareZoom(getratio(p.drawparam.width_draw_pixel, p.drawparam.width_per_line));
+    vReadArray.prepareSignalTracks(p);
+
+    runParallel(p.getNumThreads(), jobs.size(), [&] (const size_t i) {
+        const auto surface = Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, width, height);
+        PDFPage page(p, vReadArray, pairs, graphs, surface, jobs[i].start, jobs[i].end);
+        page.MakePage(p, jobs[i].page_no, jobs[i].label);
+        surface->write_to_png(vpng[i]);
+      });
+  }
+
+  /* --png: one PNG file for each page.
+     Pages drawn by a previous run with the same options and input files are skipped. */
+  void drawPngPages(const DROMPA::Global &p,
+                    const vChrArray &vReadArray,
+                    const std::vector<SamplePairOverlayed> &pairs,
+                    const GraphTracks &graphs,
+                    const int32_t width, const int32_t height,
+                    const std::vector<PageJob> &jobs)
+  {
+    const std::string chrname(vReadArray.getchr().getrefname());
+    OutputCache cache(p.getPrefixName() + ".tilecache.tsv");
+
+    std::vector<PageJob> todo;
+    std::vector<std::string> vpng, vkey;
+    for (auto &job: jobs) {
+      std::string png(p.getPrefixName() + "_" + getPageTitle(chrname, job.label, job.page_no, job.num_page) + ".png");
+      std::string key(OutputCache::getKey((boost::format("%1%\t%2%:%3%-%4%:%5%:%6%x%7%")
+                                           % p.getParamKey() % chrname % job.start % job.end % job.page_no
+                                           % width % height).str()));
+      if (p.isusecache() && cache.isUpToDate(png, key)) continue;
+      todo.emplace_back(job);
+      vpng.emplace_back(png);
+      vkey.emplace_back(key);
+    }
+
+    drawPngFiles(p, vReadArray, pairs, graphs, width, height, todo, vpng);
+
+    if (p.isusecache()) {
+      for (size_t i=0; i<todo.size(); ++i) cache.set(vpng[i], vkey[i]);
+      cache.save();
+    }
+    std::cout << boost::format("   %1% PNG files written, %2% unchanged files skipped.\n")
+      % todo.size() % (jobs.size() - todo.size());
+  }
+
+  /* With --threads > 1, pages are rendered in parallel into recording surfaces
+     and replayed into the PDF in order, so the output is the same as the serial one. */
+  void drawPdfPages(const DROMPA::Global &p,
+                    const vChrArray &vReadArray,
+                    const std::vector<SamplePairOverlayed> &pairs,
+                    const GraphTracks &graphs,
+                    const std::string &pdffilename,
+                    const int32_t width, const int32_t height,
+                    const std::vector<PageJob> &jobs)
+  {
+    const auto surface = Cairo::PdfSurface::create(pdffilename, width, height);
+    const auto cr = Cairo::Context::create(surface);
+    int32_t numthreads(std::min(p.getNumThreads(), static_cast<int32_t>(jobs.size())));
+
+    if (numthreads <= 1) {
+      for (auto &job: jobs) {
+        job.printProgress();
+        PDFPage page(p, vReadArray, pairs, graphs, surface, job.start, job.end);
+        page.MakePage(p, job.page_no, job.label);
+        cr->show_page();
+      }
+      return;
+    }
+
+    vReadArray.prepareZoom(getratio(p.drawparam.width_draw_pixel, p.drawparam.width_per_line));
+    vReadArray.prepareSignalTracks(p);
+
+    const Cairo::Rectangle extents = {0, 0, static_cast<double>(width), static_cast<double>(height)};
+    const size_t batchsize(numthreads * 4);
+    for (size_t begin=0; begin<jobs.size(); begin += batchsize) {
+      size_t end(std::min(begin + batchsize, jobs.size()));
+      std::vector<Cairo::RefPtr<Cairo::RecordingSurface>> vrec;
+      for (size_t i=begin; i<end; ++i) vrec.emplace_back(Cairo::RecordingSurface::create(Cairo::CONTENT_COLOR_ALPHA, extents));
+
+      runParallel(numthreads, end - begin, [&] (const size_t k) {
+          PDFPage page(p, vReadArray, pairs, graphs, vrec[k], jobs[begin+k].start, jobs[begin+k].end);
+          page.MakePage(p, jobs[begin+k].page_no, jobs[begin+k].label);
+        });
+
+      for (size_t i=begin; i<end; ++i) {
+        jobs[i].printProgress();
+        cr->set_source(vrec[i-begin], 0, 0);
+        cr->paint();
+        cr->show_page();
+      }
+    }
+  }
+
+  void drawPages(const DROMPA::Global &p,
+                 const vChrArray &vReadArray,
+                 const std::vector<SamplePairOverlayed> &pairs,
+                 const GraphTracks &graphs,
+                 const std::string &pdffilename,
+                 const int32_t width, const int32_t height,
+                 const std::vector<PageJob> &jobs)
+  {
+    if (p.isoutputpng()) drawPngPages(p, vReadArray, pairs, graphs, width, height, jobs);
+    else                 drawPdfPages(p, vReadArray, pairs, graphs, pdffilename, width, height, jobs);
+  }
 }
 
 void GraphData::setValue(const DROMPA::GraphDataFileName &g,
@@ -94,7 +243,7 @@ void GraphData::setValue(const DROMPA::GraphDataFileName &g,
   boxheight = BOXHEIGHT_GRAPH;
   std::string filename(g.getfilename() + "/" + chr + "-bs" + std::to_string(binsize));
   std::ifstream in(filename);
-  if (!in) PRINTERR_AND_EXIT("cannot open " << filename);
+  if (!in) throw std::runtime_error("cannot open " + filename);
 
   array = std::vector<double>(chrlen/binsize +1);
 
@@ -110,7 +259,7 @@ void GraphData::setValue(const DROMPA::GraphDataFileName &g,
     int32_t start(stoi(v[0]));
     if(start % binsize){
       printf("%d %d\n", start, binsize);
-      PRINTERR_AND_EXIT("[E]graph: invalid start position or binsize:  " << filename);
+      throw std::runtime_error("[E]graph: invalid start position or binsize:  " + filename);
     }
     double val(stod(v[1]));
     array[start/binsize] = val;
@@ -125,6 +274,9 @@ void GraphData::setValue(const DROMPA::GraphDataFileName &g,
     else mmax = maxtemp;
   }
   mwid = mmax - mmin;
+
+  ylen.resize(array.size());
+  for (size_t i=0; i<array.size(); ++i) ylen[i] = boxheight * (array[i] - mmin)/mwid;
 }
 
 void PDFPage::StrokeWidthOfInteractionSite(const bed &site, const double y)
@@ -208,7 +360,6 @@ void PDFPage::drawInteraction(const InteractionSet &vinter)
   DEBUGprint_FUNCStart();
 
   int32_t boxheight(BOXHEIGHT_INTERACTION);
-  std::string chr(rmchr(chrname));
   double ytop(par.yaxis_now);
   double ycenter(par.yaxis_now + boxheight/2);
 
@@ -219,13 +370,8 @@ void PDFPage::drawInteraction(const InteractionSet &vinter)
   cr->set_source_rgba(CLR_BLACK, 1);
   showtext_cr(cr, 70, ycenter-6, vinter.getlabel(), 12);
 
-  for (auto &x: vinter.getvinter()) {
-    //    printList(x.first.chr, x.second.chr, chr);
-    if (x.first.chr != chr && x.second.chr != chr) continue;
-
-    // interchromosomalは描画しない
-    if (x.first.chr != chr || x.second.chr != chr) continue;
-
+  // interchromosomalは描画しない
+  vinter.queryIntra(vReadArray.getchrid(), par.xstart, par.xend, [&] (const Interaction &x) {
     RGB color(getInterRGB(x.getval()/vinter.getmaxval() *3)); // maxval の 1/3 を色のmax値に設定
     cr->set_source_rgba(color.r, color.g, color.b, 0.8);
     /*    else {   // inter-chromosomal
@@ -238,13 +384,13 @@ void PDFPage::drawInteraction(const InteractionSet &vinter)
     if (par.xstart <= x.first.summit  && x.first.summit  <= par.xend) xcen_head = x.first.summit  - par.xstart;
     if (par.xstart <= x.second.summit && x.second.summit <= par.xend) xcen_tail = x.second.summit - par.xstart;
 
-    if (xcen_head < 0 && xcen_tail < 0) continue;
+    if (xcen_head < 0 && xcen_tail < 0) return;
 
     //    printf("%d, %d, %d, %d, %d, %d\n", x.first.start, x.first.summit, x.first.end, x.second.start, x.second.summit, x.second.end);
     if (xcen_head >= 0 && xcen_tail >= 0) drawArc_from_to(x, xcen_head, xcen_tail, boxheight, ytop);
     if (xcen_head > 0 && xcen_tail < 0)   drawArc_from_none(x, xcen_head, par.xend - par.xstart, boxheight, ytop);
     if (xcen_head < 0 && xcen_tail > 0)   drawArc_none_to(x, xcen_head, xcen_tail, boxheight, ytop);
-  }
+  });
   cr->stroke();
   par.yaxis_now += boxheight;
 
@@ -329,21 +475,34 @@ void PDFPage::StrokeGraph(const GraphData &graph)
   return;
 }
 
-void setcolor(const Cairo::RefPtr<Cairo::Context> &cr, bed &x)
+// alternate colors between neighboring sites
+int32_t getColorClass(const bed &x, const size_t i)
 {
-  static int32_t on(0);
-  if(!on) {
-    cr->set_source_rgba(CLR_GRAY4, 1);
-    on=1;
-  } else {
-    cr->set_source_rgba(CLR_GREEN, 1);
-    on=0;
-  }
+  (void)(x);
+  return i%2;
+}
+
+// itemRgb packed into 24 bits. Channels are clamped to 0-255 as cairo does,
+// so intervals without itemRgb (-1) are black
+int32_t getColorClass(const bed12 &x, const size_t i)
+{
+  (void)(i);
+  auto channel = [] (const int32_t c) { return static_cast<uint32_t>(std::min(std::max(c, 0), 255)); };
+  uint32_t rgb((channel(x.rgb_r) << 16) | (channel(x.rgb_g) << 8) | channel(x.rgb_b));
+  return static_cast<int32_t>(rgb);
+}
+
+void setcolor(const Cairo::RefPtr<Cairo::Context> &cr, const bed &x, const int32_t cls)
+{
+  (void)(x);
+  if (!cls) cr->set_source_rgba(CLR_GRAY4, 1);
+  else      cr->set_source_rgba(CLR_GREEN, 1);
 }
 
-void setcolor(const Cairo::RefPtr<Cairo::Context> &cr, bed12 &x)
+void setcolor(const Cairo::RefPtr<Cairo::Context> &cr, const bed12 &x, const int32_t cls)
 {
-  cr->set_source_rgba(x.rgb_r/(double)255, x.rgb_g/(double)255, x.rgb_b/(double)255, 0.6);
+  (void)(x);
+  cr->set_source_rgba((cls >> 16 & 255)/(double)255, (cls >> 8 & 255)/(double)255, (cls & 255)/(double)255, 0.6);
 }
 
 //void PDFPage::drawBedAnnotation(const vbed<auto> &vbed)
@@ -352,7 +511,6 @@ void PDFPage::drawBedAnnotation(const vbed<T> &vbed)
 {
   DEBUGprint_FUNCStart();
   int32_t boxheight(BOXHEIGHT_BEDANNOTATION);
-  std::string chr(rmchr(chrname));
   double ycenter(par.yaxis_now + boxheight/2);
 
   // label
@@ -365,18 +523,15 @@ void PDFPage::drawBedAnnotation(const vbed<T> &vbed)
 
   // bed
   cr->set_line_width(boxheight/2);
-  for (auto &x: vbed.getvBed()) {
-    if (x.chr != chr) continue;
-
-    setcolor(cr, x);
-    if (par.xstart <= x.end && x.start <= par.xend) {
+  const IntervalIndex<T> &index(vbed.getBedChr(vReadArray.getchrid()));
+  LineBatch batch;
+  index.queryIndex(par.xstart, par.xend, [&](const size_t i) {
+      const T &x(index.getValues()[i]);
       double x1 = BP2PIXEL(x.start - par.xstart);
       double len = (x.end - x.start) * par.dot_per_bp;
-      rel_xline(cr, x1, ycenter, len);
-      cr->stroke();
-    }
-  }
-  cr->stroke();
+      batch.xline(getColorClass(x, i), x1, ycenter, len);
+    });
+  batch.stroke(cr, [&](const int32_t cls) { setcolor(cr, T(), cls); });
   par.yaxis_now += boxheight;
 
   DEBUGprint_FUNCend();
@@ -446,8 +601,7 @@ void PDFPage::DrawIdeogram(const DROMPA::Global &p)
   cr->rectangle(OFFSET_X, par.yaxis_now, par.getXaxisLen(), boxheight);
   cr->stroke();
 
-  for (auto &x: p.anno.vcytoband) {
-    if (rmchr(chrname) != x.chr) continue;
+  for (auto &x: p.anno.vcytoband.get(vReadArray.getchrid())) {
     //    x.print();
     if (x.stain == "acen") cr->set_source_rgba(CLR_SALMON, 1);
     else if (x.stain == "gneg") cr->set_source_rgba(CLR_GRAY0, 1);
@@ -510,8 +664,8 @@ void PDFPage::StrokeEachLayer(const DROMPA::Global &p)
 {
   if (p.anno.showIdeogram()) DrawIdeogram(p);
 
-  if (p.anno.GC.isOn()) StrokeGraph(GC);
-  if (p.anno.GD.isOn()) StrokeGraph(GD);
+  if (p.anno.GC.isOn()) StrokeGraph(graphs.GC);
+  if (p.anno.GD.isOn()) StrokeGraph(graphs.GD);
 
   // Gene
   if (p.anno.genefile != "" || p.anno.arsfile != "" || p.anno.terfile != "")DrawGeneAnnotation(p);
@@ -565,42 +719,51 @@ void PDFPage::MakePage(const DROMPA::Global &p,
   }
 
   // Page title
-  std::string title;
-  if (pagelabel == "None") {
-    if (par.num_page>1) title = chrname  + "_" + std::to_string(page_no+1);
-    else                title = chrname;
-  } else {
-    if (par.num_page>1) title = chrname + "_" + pagelabel + "_" + std::to_string(page_no+1);
-    else                title = chrname + "_" + pagelabel;
-  }
   cr->set_source_rgba(CLR_BLACK, 1);
-  showtext_cr(cr, 50, 30, title, 16);
+  showtext_cr(cr, 50, 30, getPageTitle(chrname, pagelabel, page_no, par.num_page), 16);
   cr->stroke();
 
-  cr->show_page();
-
   DEBUGprint_FUNCend();
   return;
 }
 
+std::vector<range> Figure::getDrawnRegions(const DROMPA::Global &p, const chrsize &chr)
+{
+  std::vector<range> regions;
+  if (p.thre.sigtest) return regions;
+
+  if (p.drawregion.isRegionBed()) {
+    for (auto &x: p.drawregion.getRegionBedChr(chrdict().getID(chr.getname()))) {
+      regions.emplace_back(x.start, x.end +1);
+    }
+  } else if (p.drawregion.isGeneLociFile()) {
+    auto itr = p.anno.gmp.find(chr.getname());
+    if (itr == p.anno.gmp.end()) return regions;
+    int32_t len(p.drawregion.getLenGeneLoci());
+    for (auto &m: itr->second) {
+      if(!p.drawregion.ExistInGeneLociFile(m.second.gname)) continue;
+      regions.emplace_back(std::max(0, m.second.txStart - len), std::min(m.second.txEnd + len, chr.getlen()));
+    }
+  }
+  return regions;
+}
+
 void Figure::Draw_SpecificRegion(DROMPA::Global &p,
                                  std::string &pdffilename,
                                  int32_t width,
                                  int32_t height)
 {
-  const auto surface = Cairo::PdfSurface::create(pdffilename, width, height);
+  std::vector<PageJob> jobs;
   int32_t region_no(1);
   for (auto &x: regionBed) {
     int32_t num_page = p.drawparam.getNumPage(x.start, x.end);
     for(int32_t i=0; i<num_page; ++i) {
-      std::cout << boost::format("   page %5d/%5d/%5d\r")
-        % (i+1) % num_page % region_no << std::flush;
-      PDFPage page(p, vReadArray, vsamplepairoverlayed, surface, x.start, x.end);
-      page.MakePage(p, i, std::to_string(region_no));
+      std::string progress((boost::format("   page %5d/%5d/%5d\r") % (i+1) % num_page % region_no).str());
+      jobs.emplace_back(x.start, x.end, i, std::to_string(region_no), progress, num_page);
     }
     ++region_no;
-    printf("\n");
   }
+  drawPages(p, vReadArray, vsamplepairoverlayed, graphs, pdffilename, width, height, jobs);
 }
 
 void Figure::Draw_SpecificGene(DROMPA::Global &p,
@@ -608,7 +771,7 @@ void Figure::Draw_SpecificGene(DROMPA::Global &p,
                                int32_t width,
                                int32_t height)
 {
-  const auto surface = Cairo::PdfSurface::create(pdffilename, width, height);
+  std::vector<PageJob> jobs;
   int32_t len(p.drawregion.getLenGeneLoci());
   auto &gmp_chr = p.anno.gmp.at(vReadArray.getchr().getname());
   for (auto &m: gmp_chr) {
@@ -618,12 +781,11 @@ void Figure::Draw_SpecificGene(DROMPA::Global &p,
     int32_t end   = std::min(m.second.txEnd + len, vReadArray.getchrlen() -1);
     int32_t num_page(p.drawparam.getNumPage(start, end));
     for(int32_t i=0; i<num_page; ++i) {
-      std::cout << boost::format("   page %5d/%5d/%s\r") % (i+1) % num_page % m.second.gname << std::flush;
-      PDFPage page(p, vReadArray, vsamplepairoverlayed, surface, start, end);
-      page.MakePage(p, i, m.second.gname);
+      std::string progress((boost::format("   page %5d/%5d/%s\r") % (i+1) % num_page % m.second.gname).str());
+      jobs.emplace_back(start, end, i, m.second.gname, progress, num_page);
     }
-    printf("\n");
   }
+  drawPages(p, vReadArray, vsamplepairoverlayed, graphs, pdffilename, width, height, jobs);
 }
 
 void Figure::Draw_WholeGenome(DROMPA::Global &p,
@@ -632,16 +794,113 @@ void Figure::Draw_WholeGenome(DROMPA::Global &p,
                               int32_t height)
 {
 #ifdef CAIRO_HAS_PDF_SURFACE
-  const auto surface = Cairo::PdfSurface::create(pdffilename, width, height);
+  std::vector<PageJob> jobs;
   int32_t num_page = p.drawparam.getNumPage(0, vReadArray.getchrlen());
   for (int32_t i=0; i<num_page; ++i) {
-    std::cout << boost::format("   page %5d/%5d\r") % (i+1) % num_page << std::flush;
-    PDFPage page(p, vReadArray, vsamplepairoverlayed, surface, 0, vReadArray.getchrlen());
-    page.MakePage(p, i, "None");
+    std::string progress((boost::format("   page %5d/%5d\r") % (i+1) % num_page).str());
+    jobs.emplace_back(0, vReadArray.getchrlen(), i, "None", progress, num_page);
   }
-  printf("\n");
+  drawPages(p, vReadArray, vsamplepairoverlayed, graphs, pdffilename, width, height, jobs);
 #else
   std::cout << "You must compile cairo with PDF support for DROMPA+." << std::endl;
   return;
 #endif
 }
+
+std::vector<std::string> Figure::DrawRegion(const DROMPA::Global &p,
+                                            const int32_t start,
+                                            const int32_t end,
+                                            const std::string &output,
+                                            const bool png)
+{
+  int32_t width(p.drawparam.width_page_pixel);
+  int32_t height(p.drawparam.getPageHeight(p, vsamplepairoverlayed));
+  std::string label(std::to_string(start) + "-" + std::to_string(end));
+
+  std::vector<PageJob> jobs;
+  int32_t num_page(p.drawparam.getNumPage(start, end));
+  for (int32_t i=0; i<num_page; ++i) jobs.emplace_back(start, end, i, label, "", num_page);
+
+  if (!png) {
+    drawPdfPages(p, vReadArray, vsamplepairoverlayed, graphs, output, width, height, jobs);
+    return {output};
+  }
+
+  std::vector<std::string> vpng;
+  std::string prefix(output.size() > 4 && output.substr(output.size()-4) == ".png" ? output.substr(0, output.size()-4) : output);
+  for (int32_t i=0; i<num_page; ++i) {
+    if (num_page>1) vpng.emplace_back(prefix + "_" + std::to_string(i+1) + ".png");
+    else            vpng.emplace_back(prefix + ".png");
+  }
+  drawPngFiles(p, vReadArray, vsamplepairoverlayed, graphs, width, height, jobs, vpng);
+  return vpng;
+}
+
+void Figure::WriteRegionValues(const int32_t start,
+                               const int32_t end,
+                               const std::string &output)
+{
+  std::ofstream out(output);
+  if (!out) throw std::runtime_error("cannot open " + output);
+  out << "sample\tchromosome\tstart\tend\tChIP\tInput\tenrichment" << std::endl;
+
+  const std::string chrname(vReadArray.getchr().getrefname());
+  auto write = [&] (const SamplePairEach &pair) {
+    const ChrArray &ChIP(vReadArray.getArray(pair.argvChIP));
+    int32_t binsize(pair.getbinsize());
+    int32_t ebin(std::min(end/binsize, static_cast<int32_t>(ChIP.array.size()) -1));
+    for (int32_t i=start/binsize; i<=ebin; ++i) {
+      out << pair.label << "\t" << chrname << "\t" << i*binsize << "\t" << std::min((i+1)*binsize, vReadArray.getchrlen())
+          << "\t" << ChIP.array[i];
+      if (pair.InputExists()) {
+        out << "\t" << vReadArray.getArray(pair.argvInput).array[i] << "\t" << vReadArray.getSignalTrack(pair).getRatio()[i];
+      } else {
+        out << "\t\t";
+      }
+      out << "\n";
+    }
+  };
+  for (auto &x: vsamplepairoverlayed) {
+    write(x.first);
+    if (x.OverlayExists()) write(x.second);
+  }
+}
+
+void Figure::generateWig(const DROMPA::Global &p, const std::vector<std::vector<std::string>> &segfiles)
+{
+  DEBUGprint_FUNCStart();
+
+  class WigJob {
+  public:
+    GenwigFile &file;
+    const SignalTrack &track;
+    std::string segfile;
+    WigJob(GenwigFile &f, const SignalTrack &t, const std::string &s): file(f), track(t), segfile(s) {}
+  };
+
+  // tracks are made here; each column is then computed by one thread
+  std::vector<std::pair<const SignalTrack *, int32_t>> columns;
+  std::vector<WigJob> jobs;
+  for (size_t i=0; i<vsamplepairoverlayed.size(); ++i) {
+    auto &vfile = vsamplepairoverlayed[i].first.getGenwigFiles();
+    if (vfile.empty()) continue;
+    const SignalTrack &track(vReadArray.getSignalTrack(vsamplepairoverlayed[i].first));
+    for (size_t j=0; j<vfile.size(); ++j) {
+      auto column(std::make_pair(&track, vfile[j].getValueType()));
+      if (std::find(columns.begin(), columns.end(), column) == columns.end()) columns.emplace_back(column);
+      jobs.emplace_back(vfile[j], track, segfiles[i].empty() ? "" : segfiles[i][j]);
+    }
+  }
+
+  runParallel(p.getNumThreads(), columns.size(),
+              [&] (const size_t i) { columns[i].first->getValues(columns[i].second); });
+
+  const chrsize &chr(vReadArray.getchr());
+  runParallel(p.getNumThreads(), jobs.size(),
+              [&] (const size_t i) {
+                WigJob &job(jobs[i]);
+                job.file.write(job.track.getValues(job.file.getValueType()), chr.getrefname(), chr.getlen() -1, job.segfile);
+              });
+
+  DEBUGprint_FUNCend();
+}
@@ -6,24 +6,35 @@
 
 #include "dd_gv.hpp"
 #include "dd_readfile.hpp"
+#include "dd_draw_pdfpage.hpp"
 
 class Figure {
   vChrArray vReadArray;
+  GraphTracks graphs;
   std::vector<SamplePairOverlayed> &vsamplepairoverlayed;
-  std::vector<bed> regionBed;
+  const std::vector<bed> &regionBed;
 //  int32_t pagewidth;
 
 public:
-  Figure(DROMPA::Global &p, const chrsize &chr):
-    vReadArray(p, chr),
+  // drawregions: see vChrArray
+  Figure(DROMPA::Global &p, const chrsize &chr,
+         const std::vector<range> &drawregions=std::vector<range>()):
+    vReadArray(p, chr, drawregions),
+    graphs(p, chr),
     vsamplepairoverlayed(p.samplepair),
-    regionBed(p.drawregion.getRegionBedChr(chr.getname()))
+    regionBed(p.drawregion.getRegionBedChr(chrdict().getID(chr.getname())))
 //    pagewidth(p.drawparam.width_draw_pixel)
   {
+    setScalingFactor(p);
+  }
+
+  // scaling factors are kept in the sample pairs shared by all chromosomes
+  void setScalingFactor(const DROMPA::Global &p) {
     int32_t normtype(p.getChIPInputNormType());
+    const std::string &chrname(vReadArray.getchr().getname());
     for (auto &x: vsamplepairoverlayed) {
-      x.first.setScalingFactor(normtype, vReadArray, chr.getname());
-      if (x.OverlayExists()) x.second.setScalingFactor(normtype, vReadArray, chr.getname());
+      x.first.setScalingFactor(normtype, vReadArray, chrname);
+      if (x.OverlayExists()) x.second.setScalingFactor(normtype, vReadArray, chrname);
     }
   }
 
@@ -40,23 +51,15 @@ public:
     if (p.drawregion.isRegionBed())         Draw_SpecificRegion(p, pdffilename, width, height);
     else if (p.drawregion.isGeneLociFile()) Draw_SpecificGene(p, pdffilename, width, height);
     else                                    Draw_WholeGenome(p, pdffilename, width, height);
-    std::cout << "Wrote PDF file \"" << pdffilename << "\"" << std::endl;
+    if (!p.isoutputpng()) std::cout << "Wrote PDF file \"" << pdffilename << "\"" << std::endl;
 
     DEBUGprint_FUNCend();
     return 1;
   }
 
-  void generateWig(const std::string &chrname, const int32_t chrlen) {
-    DEBUGprint_FUNCStart();
-
-    for (auto &x: vsamplepairoverlayed) {
-      if (x.first.InputExists()) {
-        x.first.genEnrichWig(vReadArray, chrname, chrlen -1);
-      }
-
-    }
-    DEBUGprint_FUNCend();
-  }
+  /* all GENWIG files of this chromosome. The values are computed and the files are written in parallel.
+     segfiles[i][j]: segment file of the j-th file of pair i (see GenwigFile::write); empty without cache */
+  void generateWig(const DROMPA::Global &p, const std::vector<std::vector<std::string>> &segfiles);
 
   void peakcall(DROMPA::Global &p, const std::string &chrname) {
     DEBUGprint_FUNCStart();
@@ -76,6 +79,16 @@ public:
     DEBUGprint_FUNCend();
   }
 
+  // for SERVE: draw [start, end] to output (PDF, or PNG files for each page) and return the files written
+  std::vector<std::string> DrawRegion(const DROMPA::Global &p, const int32_t start, const int32_t end,
+                                      const std::string &output, const bool png);
+  // for SERVE: bin values of each sample in [start, end] as TSV
+  void WriteRegionValues(const int32_t start, const int32_t end, const std::string &output);
+
+  /* regions of chr drawn with -r or --genelocifile, to read only around them.
+     Empty (the whole chromosome) without them or when peaks are called */
+  static std::vector<range> getDrawnRegions(const DROMPA::Global &p, const chrsize &chr);
+
   void Draw_SpecificRegion(DROMPA::Global &p, std::string &pdffilename, int32_t width, int32_t height);
   void Draw_SpecificGene(DROMPA::Global &p, std::string &pdffilename, int32_t width, int32_t height);
   void Draw_WholeGenome(DROMPA::Global &p, std::string &pdffilename, int32_t width, int32_t height);
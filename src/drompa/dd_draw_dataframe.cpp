@@ -59,11 +59,24 @@ void DataFrame::StrokeSampleLabel(const SamplePairOverlayed &pair) {
   }
 }
 
+/* select the zoom level for the current page and return its bin size */
+int32_t DataFrame::setZoomLevel(const SamplePairEach &pair)
+{
+  int32_t binsize(pair.getbinsize());
+  zoomlevel = isZoomable() ? ChrArray::getZoomLevel(binsize * par.dot_per_bp) : 0;
+  return binsize << zoomlevel;
+}
+
 void DataFrame::StrokeBins(const SamplePairEach &pair,
                            const vChrArray &vReadArray,
                            const int32_t nlayer)
 {
-  int32_t binsize(pair.getbinsize());
+  if (par.isreduced) {
+    StrokeBinsReduced(pair, vReadArray, nlayer);
+    return;
+  }
+
+  int32_t binsize(setZoomLevel(pair));
   int32_t sbin(par.xstart/binsize);
   int32_t ebin(par.xend/binsize);
   double dot_per_bin(binsize * par.dot_per_bp);
@@ -75,20 +88,111 @@ void DataFrame::StrokeBins(const SamplePairEach &pair,
   if (thin > 1) cr->set_line_width(dot_per_bin*thin);
   else cr->set_line_width(dot_per_bin);
 
+  LineBatch edge, body;
+  std::map<int32_t, double> colorclass;  // class -> value for setColor()
   for (int32_t i=sbin; i<ebin; ++i, xcen += dot_per_bin) {
     if (thin > 1 && i%thin) continue;
-    StrokeEachBin(pair, vReadArray, i, xcen, yaxis, nlayer);
+    StrokeEachBin(pair, vReadArray, i, xcen, yaxis, nlayer, edge, body, colorclass);
+  }
+
+  // waku
+  edge.stroke(cr, [&](const int32_t cls) { setColor(colorclass[cls], nlayer, 1); });
+  // nakami
+  if (par.alpha) body.stroke(cr, [&](const int32_t cls) { setColor(colorclass[cls], nlayer, par.alpha); });
+}
+
+/* Bins sharing a pixel column are reduced to the highest (and the lowest) bar,
+ * and the bars of each color class are filled as one path.
+ * The size of the output depends on the page width, not on the number of bins. */
+void DataFrame::StrokeBinsReduced(const SamplePairEach &pair,
+                                  const vChrArray &vReadArray,
+                                  const int32_t nlayer)
+{
+  int32_t binsize(setZoomLevel(pair));
+  int32_t sbin(par.xstart/binsize);
+  int32_t ebin(par.xend/binsize);
+  double dot_per_bin(binsize * par.dot_per_bp);
+  double width(std::max(dot_per_bin, 1.0));
+  int32_t ncol(ceil((ebin - sbin) * dot_per_bin / width));
+  if (ncol <= 0) return;
+
+  int32_t yaxis(par.yaxis_now);  // convert to int
+  double ybase(yaxis - len_minus*(shownegative || bothdirection));
+
+  std::vector<double> lenup(ncol, 0), lendown(ncol, 0);
+  std::vector<double> valup(ncol, 0), valdown(ncol, 0);
+  for (int32_t i=sbin; i<ebin; ++i) {
+    int32_t col(std::min(static_cast<int32_t>((i - sbin) * dot_per_bin / width), ncol -1));
+    double value(getBinValue(pair, vReadArray, i, nlayer));
+    double len(getBarLength(value, nlayer));
+    if (len < lenup[col]) {
+      lenup[col] = len;
+      valup[col] = value;
+    }
+    if (len > lendown[col]) {
+      lendown[col] = len;
+      valdown[col] = value;
+    }
+  }
+
+  std::map<int32_t, double> colorclass;  // class -> value for setColor()
+  for (int32_t col=0; col<ncol; ++col) {
+    if (lenup[col])   colorclass.emplace(getColorClass(valup[col]),   valup[col]);
+    if (lendown[col]) colorclass.emplace(getColorClass(valdown[col]), valdown[col]);
+  }
+
+  auto addBars = [&] (const int32_t cls, const bool isedge) {
+    for (int32_t col=0; col<ncol; ++col) {
+      double x(OFFSET_X + col * width);
+      for (int32_t k=0; k<2; ++k) {
+        double len(k ? lendown[col] : lenup[col]);
+        double val(k ? valdown[col] : valup[col]);
+        if (!len || getColorClass(val) != cls) continue;
+        if (isedge) {
+          cr->rectangle(x, static_cast<int32_t>(ybase + offset_edge + len), width, LEN_EDGE);
+        } else {
+          int32_t y(ybase);
+          cr->rectangle(x, y, width, static_cast<int32_t>(ybase + len) - y);
+        }
+      }
+    }
+    cr->fill();
+  };
+
+  for (auto &x: colorclass) {
+    // waku
+    setColor(x.second, nlayer, 1);
+    addBars(x.first, true);
+    // nakami
+    if (par.alpha) {
+      setColor(x.second, nlayer, par.alpha);
+      addBars(x.first, false);
+    }
   }
-  cr->stroke();
 }
 
 void DataFrame::StrokeEachBin(const SamplePairEach &pair,
                               const vChrArray &vReadArray,
                               const int32_t i, const double xcen,
-                              const int32_t yaxis, const int32_t nlayer)
+                              const int32_t yaxis, const int32_t nlayer,
+                              LineBatch &edge, LineBatch &body,
+                              std::map<int32_t, double> &colorclass)
+{
+  double value(getBinValue(pair, vReadArray, i, nlayer));
+  double len(getBarLength(value, nlayer));
+  if (!len) return;
+
+  double ybase(yaxis - len_minus*(shownegative || bothdirection));
+  int32_t cls(getColorClass(value));
+  colorclass.emplace(cls, value);
+
+  edge.yline(cls, xcen, ybase + offset_edge + len, LEN_EDGE);
+  body.yline(cls, xcen, ybase, len);
+}
+
+double DataFrame::getBarLength(const double value, const int32_t nlayer) const
 {
-  double value(getVal(pair, vReadArray, i));
-  if (!value) return;
+  if (!value) return 0;
 
   double len(0);
   if (!nlayer) len = par.ystep * value / scale;
@@ -97,57 +201,17 @@ void DataFrame::StrokeEachBin(const SamplePairEach &pair,
     if (value > 0)      len = -std::min(len,  len_plus);
     else if (value < 0) len = -std::max(len, -len_minus);
   } else                len = -std::min(len,  height_df);
-  if (!len) return;
 
-  /*  DEBUGprint("value " << value
-      << " ystep:" << par.ystep
-      << " scale:" << scale
-      << " len:" << len
-      << " height_df " << height_df
-      << " yaxis" << yaxis
-      << " len_binedge" << len_binedge
-      << " len_minus " << len_minus);*/
-
-  // waku
-  setColor(value, nlayer, 1);
-  rel_yline(cr, xcen, yaxis -2 + len - len_minus*shownegative, LEN_EDGE);
-  cr->stroke();
-
-  // nakami
-  if (par.alpha) {
-    setColor(value, nlayer, par.alpha);
-    rel_yline(cr, xcen, yaxis - len_minus*shownegative, len);
-    cr->stroke();
-  }
+  return len;
 }
 
-void LogRatioDataFrame::StrokeEachBin(const SamplePairEach &pair,
-                                      const vChrArray &vReadArray,
-                                      const int32_t i,
-                                      const double xcen,
-                                      const int32_t yaxis,
-                                      const int32_t nlayer)
+double LogRatioDataFrame::getBarLength(const double value, const int32_t nlayer) const
 {
-  double value(getVal(pair, vReadArray, i));
-  if (!nlayer) value = value ? log(value) / log(scale): 0;
-  else         value = value ? log(value) / log(scale2nd): 0;
-
+  (void)(nlayer);
   int32_t len(0);
   if (value > 0)      len = -std::min(par.ystep*value,  len_plus);
   else if (value < 0) len = -std::max(par.ystep*value, -len_minus);
-  if (!len) return;
-
-  // waku
-  setColor(value, nlayer, 1);
-  rel_yline(cr, xcen, yaxis + len - len_minus, LEN_EDGE);
-  cr->stroke();
-
-  // nakami
-  if (par.alpha) {
-    setColor(value, nlayer, par.alpha);
-    rel_yline(cr, xcen, yaxis - len_minus, len);
-    cr->stroke();
-  }
+  return len;
 }
 
 // SetColor
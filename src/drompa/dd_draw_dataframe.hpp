@@ -4,6 +4,7 @@
 #ifndef _DD_DRAW_DATAFRAME_H_
 #define _DD_DRAW_DATAFRAME_H_
 
+#include <map>
 #include "dd_draw_pdfpage.hpp"
 #include "color.hpp"
 
@@ -19,10 +20,13 @@ class DataFrame {
     cr->stroke();
   }
 
+  int32_t setZoomLevel(const SamplePairEach &pair);
   void StrokeBins(const SamplePairEach &pair, const vChrArray &vReadArray, const int32_t nlayer);
-  virtual void StrokeEachBin(const SamplePairEach &pair, const vChrArray &vReadArray,
-                             const int32_t i, const double xcen, const int32_t yaxis,
-                             const int32_t nlayer);
+  void StrokeBinsReduced(const SamplePairEach &pair, const vChrArray &vReadArray, const int32_t nlayer);
+  void StrokeEachBin(const SamplePairEach &pair, const vChrArray &vReadArray,
+                     const int32_t i, const double xcen, const int32_t yaxis,
+                     const int32_t nlayer, LineBatch &edge, LineBatch &body,
+                     std::map<int32_t, double> &colorclass);
 
 protected:
   enum { POSI_ASSAYLABEL=6, POSI_XLABEL=66, LEN_EDGE=2};
@@ -40,10 +44,30 @@ protected:
   bool sigtest;
   double threshold;
   std::string chrname;
+  int32_t chrid;
   bool shownegative;
 
   bool bothdirection;
   uint32_t ndigit;
+  double offset_edge;
+  int32_t zoomlevel;
+
+  // bin i of the current zoom level
+  double getBinMean(const ChrArray &a, const int32_t i) const {
+    return zoomlevel ? a.getZoomMean(zoomlevel)[i] : a.array[i];
+  }
+  double getBinMax(const ChrArray &a, const int32_t i) const {
+    return zoomlevel ? a.getZoomMax(zoomlevel)[i] : a.array[i];
+  }
+  // false if getVal() needs the original bins
+  virtual bool isZoomable() const { return true; }
+
+  double getRatio(const SamplePairEach &pair, const vChrArray &vReadArray, const int32_t i) const {
+    if (!zoomlevel) return vReadArray.getSignalTrack(pair).getRatio()[i];
+    return CalcRatio(getBinMean(vReadArray.getArray(pair.argvChIP), i),
+                     getBinMean(vReadArray.getArray(pair.argvInput), i),
+                     pair.ratio);
+  }
 
   double getEthre(const DROMPA::Global &p) const {
     if (p.isGV) return p.drawparam.scale_ratio;
@@ -62,8 +86,8 @@ protected:
     barnum_plus(refparam.barnum - barnum_minus),
     len_minus(barnum_minus*par.ystep),
     len_plus(barnum_plus*par.ystep),
-    sigtest(sig), threshold(thre), chrname(_chrname),
-    shownegative(false), bothdirection(false), ndigit(1)
+    sigtest(sig), threshold(thre), chrname(_chrname), chrid(chrdict().getID(_chrname)),
+    shownegative(false), bothdirection(false), ndigit(1), offset_edge(-LEN_EDGE), zoomlevel(0)
   {
     if (slocal1) scale    = slocal1; else scale    = sglobal;
     if (slocal2) scale2nd = slocal2; else scale2nd = sglobal;
@@ -78,6 +102,18 @@ protected:
   virtual void setColor(const double value, const int32_t nlayer, const double alpha);
   virtual double getVal(const SamplePairEach &pair, const vChrArray &vReadArray, const int32_t i)=0;
   virtual const std::string getAssayName() const =0;
+
+  // value passed to setColor() and getBarLength()
+  virtual double getBinValue(const SamplePairEach &pair, const vChrArray &vReadArray,
+                             const int32_t i, const int32_t nlayer) {
+    (void)(nlayer);
+    return getVal(pair, vReadArray, i);
+  }
+  // signed length of the bar in pixel (negative: upward)
+  virtual double getBarLength(const double value, const int32_t nlayer) const;
+  // bins of the same class are drawn with the same color by setColor()
+  virtual int32_t getColorClass(const double value) const { (void)(value); return 0; }
+
   virtual double get_yscale_num(int32_t i, double scale) const {
     if (shownegative) return (i - barnum_minus) * scale;
     else return i*scale;
@@ -89,7 +125,8 @@ protected:
 
 class ChIPDataFrame : public DataFrame {
   double getVal(const SamplePairEach &pair, const vChrArray &vReadArray, const int32_t i) {
-    return vReadArray.getArray(pair.argvChIP).array[i];
+    const ChrArray &a = vReadArray.getArray(pair.argvChIP);
+    return shownegative ? getBinMean(a, i) : getBinMax(a, i);
   }
 
   void getColor1st(const double alpha) { cr->set_source_rgba(CLR_GREEN3, alpha); }
@@ -111,7 +148,7 @@ class ChIPDataFrame : public DataFrame {
   }
 
   template <class T>
-  void strokePeaks(T &bed) {
+  void strokePeaks(const T &bed) {
     if (!my_overlap(bed.start, bed.end, par.xstart, par.xend)) return;
 
     int32_t s(std::max(bed.start, par.xstart) - par.xstart);
@@ -131,14 +168,11 @@ class ChIPDataFrame : public DataFrame {
     cr->set_line_width(height_df + 6);
 
     if (pair.first.BedExists()) { // specified BED
-      for (auto &peak: pair.first.getBedChr(chrname)) {
-        strokePeaks<bed>(peak);
-      }
+      pair.first.getBedChr(chrid).query(par.xstart, par.xend,
+                                          [this](const bed &peak) { strokePeaks<bed>(peak); });
     } else {     // peak calling by DROMPA+
-      for (auto &peak: pair.first.getPeakChr(chrname)) {
-        //	peak.print();
-        strokePeaks<Peak>(peak);
-      }
+      pair.first.getPeakChr(chrid).query(par.xstart, par.xend,
+                                           [this](const Peak &peak) { strokePeaks<Peak>(peak); });
     }
 
     cr->stroke();
@@ -147,7 +181,8 @@ class ChIPDataFrame : public DataFrame {
 
 class InputDataFrame : public DataFrame {
   double getVal(const SamplePairEach &pair, const vChrArray &vReadArray, const int32_t i) {
-    return vReadArray.getArray(pair.argvInput).array[i];
+    const ChrArray &a = vReadArray.getArray(pair.argvInput);
+    return shownegative ? getBinMean(a, i) : getBinMax(a, i);
   }
 
   void getColor1st(const double alpha) { cr->set_source_rgba(CLR_BLUE, alpha); }
@@ -173,12 +208,13 @@ class RatioDataFrame : public DataFrame {
   bool isGV;
 
   void setColor(const double value, const int32_t nlayer, const double alpha);
+  int32_t getColorClass(const double value) const {
+    return (isGV || sigtest) && value >= threshold;
+  }
 
   double getVal(const SamplePairEach &pair, const vChrArray &vReadArray, const int32_t i)
   {
-    return CalcRatio(vReadArray.getArray(pair.argvChIP).array[i],
-                     vReadArray.getArray(pair.argvInput).array[i],
-                     pair.ratio);
+    return getRatio(pair, vReadArray, i);
   }
 
   void getColor1st(const double alpha) { cr->set_source_rgba(CLR_ORANGE, alpha); }
@@ -203,6 +239,9 @@ class LogRatioDataFrame : public DataFrame {
   bool isGV;
 
   void setColor(const double value, const int32_t nlayer, const double alpha);
+  int32_t getColorClass(const double value) const {
+    return (isGV || sigtest) && value >= 0;
+  }
 
   void getColor1st(const double alpha) { cr->set_source_rgba(CLR_ORANGE, alpha); }
   void getColor2nd(const double alpha) { cr->set_source_rgba(CLR_DEEPSKYBLUE, alpha); }
@@ -210,18 +249,20 @@ class LogRatioDataFrame : public DataFrame {
 
   double getVal(const SamplePairEach &pair, const vChrArray &vReadArray, const int32_t i)
   {
-    return CalcRatio(vReadArray.getArray(pair.argvChIP).array[i],
-                     vReadArray.getArray(pair.argvInput).array[i],
-                     pair.ratio);
+    return getRatio(pair, vReadArray, i);
   }
 
   double get_yscale_num(int32_t i, double scale) const {
     return std::pow(scale, i - barnum_minus);
   }
 
-  void StrokeEachBin(const SamplePairEach &pair, const vChrArray &vReadArray,
-                     const int32_t i, const double xcen, const int32_t yaxis,
-                     const int32_t nlayer);
+  double getBinValue(const SamplePairEach &pair, const vChrArray &vReadArray,
+                     const int32_t i, const int32_t nlayer) {
+    double value(getVal(pair, vReadArray, i));
+    if (!nlayer) return value ? log(value) / log(scale): 0;
+    else         return value ? log(value) / log(scale2nd): 0;
+  }
+  double getBarLength(const double value, const int32_t nlayer) const;
 
 public:
   LogRatioDataFrame(const Cairo::RefPtr<Cairo::Context> cr_, const DROMPA::Global &p,
@@ -235,11 +276,14 @@ public:
   {
     bothdirection = true;
     ndigit = 2;
+    offset_edge = 0;
   }
 };
 
 class PvalueDataFrame : public DataFrame {
+  bool isZoomable() const { return false; }
   void setColor(const double value, const int32_t nlayer, const double alpha);
+  int32_t getColorClass(const double value) const { return value >= threshold; }
   virtual double getVal(const SamplePairEach &pair, const vChrArray &vReadArray, const int32_t i)=0;
   void getColor1st(const double alpha) { cr->set_source_rgba(CLR_RED, alpha); }
   void getColor2nd(const double alpha) { cr->set_source_rgba(CLR_BLUE, alpha); }
@@ -264,10 +308,7 @@ public:
 
 class PinterDataFrame : public PvalueDataFrame {
   double getVal(const SamplePairEach &pair, const vChrArray &vReadArray, const int32_t i) {
-    const ChrArray &a = vReadArray.getArray(pair.argvChIP);
-    double myu(a.array.getLocalAverage(i, a.binsize));
-
-    return getlogp_Poisson(a.array[i], myu);
+    return vReadArray.getSignalTrack(pair).getPinter()[i];
   }
   const std::string getAssayName() const { return "logp(ChIP)"; }
 
@@ -281,9 +322,7 @@ public:
 
 class PenrichDataFrame : public PvalueDataFrame {
   double getVal(const SamplePairEach &pair, const vChrArray &vReadArray, const int32_t i) {
-    return getlogp_BinomialTest(vReadArray.getArray(pair.argvChIP).array[i],
-                                vReadArray.getArray(pair.argvInput).array[i],
-                                pair.ratio);
+    return vReadArray.getSignalTrack(pair).getPenrich()[i];
   }
   const std::string getAssayName() const { return "logp(Enrich)"; }
 
@@ -7,6 +7,8 @@
 #include <iostream>
 #include <sstream>
 #include <iomanip>
+#include <map>
+#include <vector>
 #include <cairommconfig.h>
 #include <cairomm/context.h>
 #include <cairomm/surface.h>
@@ -27,6 +29,42 @@
     cr->rel_line_to((x1) - (x3), (y1) - (y3));	       \
     cr->close_path(); } while(0)
 
+/* line segments grouped by color class and stroked once for each class.
+ * y coordinates are rounded as in rel_xline() and rel_yline(). */
+class LineBatch {
+  class Line {
+  public:
+    double x1, y1, x2, y2;
+    Line(const double _x1, const double _y1, const double _x2, const double _y2):
+      x1(_x1), y1(_y1), x2(_x2), y2(_y2) {}
+  };
+  std::map<int32_t, std::vector<Line>> lines;
+
+public:
+  LineBatch() {}
+
+  void xline(const int32_t cls, const double x, const double y, const double xlen) {
+    lines[cls].emplace_back(x, (int32_t)y, x + xlen, (int32_t)y);
+  }
+  void yline(const int32_t cls, const double x, const double y, const double ylen) {
+    lines[cls].emplace_back(x, (int32_t)y, x, (int32_t)(y + ylen));
+  }
+
+  // setcolor(cls) is called before stroking each class
+  template <class Func>
+  void stroke(const Cairo::RefPtr<Cairo::Context> cr, Func setcolor) {
+    for (auto &x: lines) {
+      setcolor(x.first);
+      for (auto &l: x.second) {
+        cr->move_to(l.x1, l.y1);
+        cr->line_to(l.x2, l.y2);
+      }
+      cr->stroke();
+    }
+    lines.clear();
+  }
+};
+
 inline double CalcRatio(const double c, const double i, const double r)
 {
   return i ? c/i*r: 0;
@@ -38,6 +38,7 @@ public:
   double dot_per_bp;
 
   double alpha;
+  bool isreduced;
 
   DParam(const int32_t s, const int32_t e, const DROMPA::Global &p):
     pstart(0), pend(0), start(s), end(e),
@@ -48,7 +49,8 @@ public:
     height_df(p.drawparam.getHeightDf()),
     width_draw(p.drawparam.width_draw_pixel),
     dot_per_bp(getratio(width_draw, width_per_line)),
-    alpha(p.drawparam.alpha)
+    alpha(p.drawparam.alpha),
+    isreduced(p.drawparam.isReducedRendering())
   {}
 
   void set_xstart_xend(const int32_t i) {
@@ -66,6 +68,7 @@ class GraphData {
 public:
   int32_t binsize;
   std::vector<double> array;
+  std::vector<double> ylen;  // height of each bin in the box, set with the y-range
   std::string label;
   int32_t memnum;
   int32_t boxheight;
@@ -79,9 +82,7 @@ public:
 		const std::string &chr, const int32_t chrlen,
 		const std::string &l,	const double ymin, const double ymax);
 
-  double getylen(const int32_t i) const {
-    return boxheight * (array[i] - mmin)/mwid;
-  }
+  double getylen(const int32_t i) const { return ylen[i]; }
   double getBoxHeight4mem() const { return boxheight/memnum; }
 
   const std::string getmemory(const int32_t i) const {
@@ -93,13 +94,24 @@ public:
   }
 };
 
+/* --GC and --GD graphs of a chromosome, read once by Figure and shared by its pages */
+class GraphTracks {
+public:
+  GraphData GC, GD;
+
+  GraphTracks(const DROMPA::Global &p, const chrsize &chr) {
+    if (p.anno.GC.isOn()) GC.setValue(p.anno.GC, chr.getrefname(), chr.getlen(), "GC%",          20, 70);
+    if (p.anno.GD.isOn()) GD.setValue(p.anno.GD, chr.getrefname(), chr.getlen(), "Num of genes", 0, 40);
+  }
+};
+
 class PDFPage {
   enum {GFTYPE_REFFLAT=0, GFTYPE_GTF=1, GFTYPE_SGD=2};
 
   const vChrArray &vReadArray;
   std::string chrname;
   const std::vector<SamplePairOverlayed> &vsamplepairoverlayed;
-  GraphData GC, GD;
+  const GraphTracks &graphs;
 
   Cairo::RefPtr<Cairo::Context> cr;
 
@@ -116,7 +128,7 @@ class PDFPage {
   void StrokeGraph(const GraphData &graph);
   void DrawIdeogram(const DROMPA::Global &p);
   void DrawGeneAnnotation(const DROMPA::Global &p);
-  void strokeARS(const HashOfGeneDataMap &mp, const double ycenter);
+  void strokeARS(const ChrGeneIndex &index, const double ycenter);
   void strokeGeneSGD(const DROMPA::Global &p, const double ycenter);
   void strokeGene(const DROMPA::Global &p, const double ycenter);
 
@@ -125,7 +137,7 @@ class PDFPage {
 //  void drawBedAnnotation(const vbed<auto> &vbed);
   void drawInteraction(const InteractionSet &vinter);
   void StrokeChIADrop(const DROMPA::Global &p);
-  void strokeChIADropBarcode(const std::vector<int32_t> &v, const std::string &nbarcode, const double _ywidth, const double yaxis, const RGB &color);
+  void strokeChIADropBarcode(const ChIADropFragments &frag, const uint32_t id, const int32_t nbarcode, const double _ywidth, const double yaxis, const RGB &color);
 
   public:
   DParam par;
@@ -133,17 +145,17 @@ class PDFPage {
   PDFPage(const DROMPA::Global &p,
           const vChrArray &_vReadArray,
           const std::vector<SamplePairOverlayed> &pair,
-          const Cairo::RefPtr<Cairo::PdfSurface> surface,
+          const GraphTracks &_graphs,
+          const Cairo::RefPtr<Cairo::Surface> surface,
           const int32_t s, const int32_t e):
     vReadArray(_vReadArray),
     chrname(vReadArray.getchr().getrefname()),
     vsamplepairoverlayed(pair),
+    graphs(_graphs),
     cr(Cairo::Context::create(surface)),
     par(s, e, p)
   {
     cr->select_font_face( "Arial", Cairo::FONT_SLANT_NORMAL, Cairo::FONT_WEIGHT_NORMAL);
-    if(p.anno.GC.isOn()) GC.setValue(p.anno.GC, chrname, vReadArray.getchrlen(), "GC%",         20, 70);
-    if(p.anno.GD.isOn()) GD.setValue(p.anno.GD, chrname, vReadArray.getchrlen(), "Num of genes", 0, 40);
   }
 
   template <class T>
@@ -33,12 +33,12 @@ namespace {
 
       if (!ty) { // SGD
 	x_name = xcen - 3.25 * m.gname.length() + 6;
-	if (m.strand == "+") {
+	if (m.isPlus()) {
 	  ybar   = ycenter - dif;
 	  y_name = ybar -5 - on_minus*6;
 	  if (on_minus == cnt) on_minus=0; else ++on_minus;
 	}
-	else if (m.strand == "-") {
+	else if (m.isMinus()) {
 	  ybar   = ycenter + dif;
 	  y_name = ybar +9 + on_plus*6;
 	  if (on_plus == cnt) on_plus=0; else ++on_plus;
@@ -46,7 +46,7 @@ namespace {
 	else y_name = ycenter -22;
 	ylen = y_name - ycenter;
       } else {  // Others
-	if (m.strand == "+") {
+	if (m.isPlus()) {
 	  ybar = ycenter - 8 - on_minus * 8;
 	  if (on_minus==7) on_minus=0; else ++on_minus;
 	} else{
@@ -62,6 +62,70 @@ namespace {
     }
   };
 
+  enum GeneColor {GCLR_BLUE, GCLR_GREEN, GCLR_PINK, GCLR_ORANGE, GCLR_GRAY2,
+                  GCLR_BLACK, GCLR_RED, GCLR_OLIVE, GCLR_PURPLE};
+
+  int32_t getGeneColor(const Biotype type)
+  {
+    switch (type) {
+    case Biotype::PROTEIN_CODING: return GCLR_BLUE;
+    case Biotype::NONCODING_UCSC: return GCLR_GREEN;  // UCSC
+    case Biotype::LINCRNA:        return GCLR_PINK;
+    case Biotype::ANTISENSE:      return GCLR_GREEN;
+    case Biotype::RRNA:
+    case Biotype::TRNA:
+    case Biotype::OTHER_RNA:      return GCLR_ORANGE;
+    case Biotype::PSEUDO:         return GCLR_GRAY2;
+    default:                      return GCLR_BLACK;
+    }
+  }
+
+  int32_t getGeneColorSGD(const Biotype type)
+  {
+    switch (type) {
+    case Biotype::RRNA:   return GCLR_BLACK;
+    case Biotype::LTR:
+    case Biotype::REPEAT: return GCLR_PURPLE;
+    case Biotype::TRNA:   return GCLR_GREEN;
+    default:              return GCLR_BLUE;
+    }
+  }
+
+  void setGeneColor(const Cairo::RefPtr<Cairo::Context> cr, const int32_t cls)
+  {
+    switch (cls) {
+    case GCLR_BLUE:   cr->set_source_rgba(CLR_BLUE, 1);   break;
+    case GCLR_GREEN:  cr->set_source_rgba(CLR_GREEN, 1);  break;
+    case GCLR_PINK:   cr->set_source_rgba(CLR_PINK, 1);   break;
+    case GCLR_ORANGE: cr->set_source_rgba(CLR_ORANGE, 1); break;
+    case GCLR_GRAY2:  cr->set_source_rgba(CLR_GRAY2, 1);  break;
+    case GCLR_RED:    cr->set_source_rgba(CLR_RED, 1);    break;
+    case GCLR_OLIVE:  cr->set_source_rgba(CLR_OLIVE, 1);  break;
+    case GCLR_PURPLE: cr->set_source_rgba(CLR_PURPLE, 1); break;
+    default:          cr->set_source_rgba(CLR_BLACK, 1);  break;
+    }
+  }
+
+  // gene names are drawn after the lines of all genes
+  class GeneLabel {
+  public:
+    double x;
+    int32_t y;
+    int32_t cls;
+    int32_t fontsize;
+    std::string name;
+    GeneLabel(const double _x, const int32_t _y, const int32_t c, const int32_t f, const std::string &n):
+      x(_x), y(_y), cls(c), fontsize(f), name(n) {}
+  };
+
+  void showGeneLabels(const Cairo::RefPtr<Cairo::Context> cr, const std::vector<GeneLabel> &labels)
+  {
+    for (auto &x: labels) {
+      setGeneColor(cr, x.cls);
+      showtext_cr(cr, x.x, x.y, x.name, x.fontsize);
+    }
+  }
+
   void ShowColorAnnotation(const Cairo::RefPtr<Cairo::Context> cr, const int32_t x, int32_t &ycen,
 			   const std::string &label, const double r, const double g, const double b)
   {
@@ -73,54 +137,41 @@ namespace {
     ycen += 15;
     return;
   }
-
-  std::vector<genedata> get_garray(const GeneDataMap &mp, const int32_t xstart, const int32_t xend)
-  {
-    std::vector<genedata> garray;
-    for (auto &m: mp) {
-      if (!my_overlap(m.second.txStart, m.second.txEnd, xstart, xend)) continue;
-      if (m.second.gtype == "nonsense_mediated_decay" ||
-	  m.second.gtype == "processed_transcript" ||
-	  m.second.gtype == "retained_intron") continue;
-      garray.emplace_back(m.second);
-    }
-    sort(garray.begin(), garray.end(),
-	 [](const genedata &x, const genedata &y) { return x.txStart < y.txStart;});
-    return garray;
-  }
 }
 
-void PDFPage::strokeARS(const HashOfGeneDataMap &mp, const double ycenter)
+void PDFPage::strokeARS(const ChrGeneIndex &index, const double ycenter)
 {
   cr->set_line_width(0.3);
-  try {
-    std::vector<genedata> garray(get_garray(mp.at(rmchr(chrname)), par.xstart, par.xend));
+  const GeneIndex &gindex(index.get(vReadArray.getchrid()));
+  if (gindex.empty()) {
+    std::cerr << "Warning: " << chrname << " has no gene." << std::endl;
+  } else {
+    auto garray(gindex.getOverlap(par.xstart, par.xend));
 
     int32_t ars_on(0);
     int32_t on_plus(0);
     int32_t on_minus(0);
-    for (auto &m: garray) {
+    for (auto pgene: garray) {
+      const genedata &m(*pgene);
       GeneElement g(m, par, ycenter, 0, on_plus, on_minus);
 
-      if (m.gtype=="ARS") {
+      if (m.biotype == Biotype::ARS) {
 	cr->set_source_rgba(CLR_RED, 1);
 	rel_yline(cr, g.xcen, ycenter -2, g.ylen +14 - 8 * ars_on);
 	showtext_cr(cr, g.x_name, g.y_name +8 - ars_on*8, m.gname, 8);
 	if (ars_on==2) ars_on=0; else ++ars_on;
       }
-      else if (m.gtype=="centromere") {
+      else if (m.biotype == Biotype::CENTROMERE) {
 	cr->set_source_rgba(CLR_GREEN, 1);
 	rel_yline(cr, g.xcen, ycenter -2, g.ylen -2);
 	showtext_cr(cr, g.x_name, g.y_name -8, m.gname, 8);
       }
-      else if (m.gtype=="teromere") {
+      else if (m.biotype == Biotype::TELOMERE) {
 	cr->set_source_rgba(CLR_OLIVE, 1);
 	rel_yline(cr, g.xcen, ycenter -2, g.ylen -5);
 	showtext_cr(cr, g.x_name, g.y_name -11, m.gname, 7);
       }else continue;
     }
-  } catch (...) {
-    std::cerr << "Warning: " << chrname << " has no gene." << std::endl;
   }
 
   return;
@@ -137,63 +188,47 @@ void PDFPage::strokeGeneSGD(const DROMPA::Global &p, const double ycenter)
   ShowColorAnnotation(cr, 50, ycen, "rRNA",      CLR_BLACK);
   ShowColorAnnotation(cr, 50, ycen, "LTR",       CLR_PURPLE);
 
-  try {
-    std::vector<genedata> garray(get_garray(p.anno.gmp.at(rmchr(chrname)), par.xstart, par.xend));
+  const GeneIndex &gindex(p.anno.gindex.get(vReadArray.getchrid()));
+  if (gindex.empty()) {
+    std::cerr << "Warning: " << chrname << " has no gene." << std::endl;
+  } else {
+    auto garray(gindex.getOverlap(par.xstart, par.xend));
 
     int32_t ars_on(0);
     int32_t on_plus(0);
     int32_t on_minus(0);
-    for (auto &m: garray) {
+    LineBatch site, body;
+    std::vector<GeneLabel> labels;
+    for (auto pgene: garray) {
+      const genedata &m(*pgene);
       GeneElement g(m, par, ycenter, 0, on_plus, on_minus);
 
-      cr->set_line_width(0.3);
-      if (m.gtype=="centromere" || m.gtype=="teromere") {
-        cr->set_source_rgba(CLR_GREEN, 1);
-        rel_yline(cr, g.xcen, ycenter -2, g.ylen);
-        showtext_cr(cr, g.x_name, g.y_name-6, m.gname, 8);
+      if (m.biotype == Biotype::CENTROMERE || m.biotype == Biotype::TELOMERE) {
+        site.yline(GCLR_GREEN, g.xcen, ycenter -2, g.ylen);
+        labels.emplace_back(g.x_name, g.y_name-6, GCLR_GREEN, 8, m.gname);
       }
-      else if (m.gtype=="ARS") {
-        cr->set_source_rgba(CLR_RED, 1);
-        rel_yline(cr, g.xcen, ycenter -2, g.ylen +10 - ars_on*8);
-        showtext_cr(cr, g.x_name, g.y_name +4 - ars_on*8, m.gname, 7);
+      else if (m.biotype == Biotype::ARS) {
+        site.yline(GCLR_RED, g.xcen, ycenter -2, g.ylen +10 - ars_on*8);
+        labels.emplace_back(g.x_name, g.y_name +4 - ars_on*8, GCLR_RED, 7, m.gname);
         if (ars_on==2) ars_on=0; else ++ars_on;
       }
-      else if (m.gtype=="TER") {
-        cr->set_source_rgba(CLR_OLIVE, 1);
-        rel_yline(cr, g.xcen, ycenter -2, g.ylen -5);
-        showtext_cr(cr, g.x_name, g.y_name-11, m.gname, 7);
-      }
-      else if (m.gtype=="rRNA" || m.gtype=="snoRNA") {
-        cr->set_source_rgba(CLR_BLACK, 1);
-        showtext_cr(cr, g.x_name, g.y_name, m.gname, 6);
-        cr->set_line_width(1.5);
-        rel_xline(cr, g.x1, g.ybar, g.xwid);
-        cr->stroke();
-      }
-      else if (m.gtype=="LTR" || m.gtype=="retrotransposon" || isStr(m.gtype, "repeat")) {
-        cr->set_source_rgba(CLR_PURPLE, 1);
-        showtext_cr(cr, g.x_name, g.y_name, m.gname, 6);
-        cr->set_line_width(1.5);
-        rel_xline(cr, g.x1, g.ybar, g.xwid);
-        cr->stroke();
-      }
-      else if (m.gtype=="tRNA") {
-        cr->set_source_rgba(CLR_GREEN, 1);
-        showtext_cr(cr, g.x_name, g.y_name, m.gname, 6);
-        cr->set_line_width(1.5);
-        rel_xline(cr, g.x1, g.ybar, g.xwid);
-        cr->stroke();
+      else if (m.biotype == Biotype::TER) {
+        site.yline(GCLR_OLIVE, g.xcen, ycenter -2, g.ylen -5);
+        labels.emplace_back(g.x_name, g.y_name-11, GCLR_OLIVE, 7, m.gname);
       }
       else {
-        cr->set_source_rgba(CLR_BLUE, 1);
-        showtext_cr(cr, g.x_name, g.y_name, m.gname, 6);
-        cr->set_line_width(1.5);
-        rel_xline(cr, g.x1, g.ybar, g.xwid);
-        cr->stroke();
+        int32_t cls(getGeneColorSGD(m.biotype));
+        body.xline(cls, g.x1, g.ybar, g.xwid);
+        labels.emplace_back(g.x_name, g.y_name, cls, 6, m.gname);
       }
     }
-  } catch (...) {
-    std::cerr << "Warning: " << chrname  << " has no gene." << std::endl;
+
+    auto setcolor = [this](const int32_t cls) { setGeneColor(cr, cls); };
+    cr->set_line_width(0.3);
+    site.stroke(cr, setcolor);
+    cr->set_line_width(1.5);
+    body.stroke(cr, setcolor);
+    showGeneLabels(cr, labels);
   }
 
   DEBUGprint_FUNCend();
@@ -219,52 +254,50 @@ void PDFPage::strokeGene(const DROMPA::Global &p, const double ycenter)
     ShowColorAnnotation(cr, 50, ycen, "Others", CLR_BLACK);
   }
 
-  try {
-    std::vector<genedata> garray(get_garray(p.anno.gmp.at(rmchr(chrname)), par.xstart, par.xend));
+  const GeneIndex &gindex(p.anno.gindex.get(vReadArray.getchrid()));
+  if (gindex.empty()) {
+    std::cerr << "Warning: " << chrname << " has no gene." << std::endl;
+  } else {
+    auto garray(gindex.getOverlap(par.xstart, par.xend));
 
     double llimit(150);
     double rlimit(OFFSET_X + p.drawparam.width_draw_pixel + 60);
     int32_t on_plus(0);
     int32_t on_minus(0);
-    for (auto &m: garray) {
+    LineBatch edge, body, exon;
+    std::vector<GeneLabel> labels;
+    for (auto pgene: garray) {
+      const genedata &m(*pgene);
       GeneElement g(m, par, ycenter, 1, on_plus, on_minus);
 
-      if (isStr(m.gtype, "protein_coding")) cr->set_source_rgba(CLR_BLUE, 1);
-      else if (isStr(m.gtype, "noncoding RNA")) cr->set_source_rgba(CLR_GREEN, 1); // UCSC
-      else if (isStr(m.gtype, "lincRNA"))   cr->set_source_rgba(CLR_PINK, 1);
-      else if (isStr(m.gtype, "antisense")) cr->set_source_rgba(CLR_GREEN, 1);
-      else if (isStr(m.gtype, "RNA"))       cr->set_source_rgba(CLR_ORANGE, 1);
-      else if (isStr(m.gtype, "pseudo"))    cr->set_source_rgba(CLR_GRAY2, 1);
-      else                                  cr->set_source_rgba(CLR_BLACK, 1);
+      int32_t cls(getGeneColor(m.biotype));
 
       // Gene body
-      cr->set_line_width(1.5);
-      if (g.x1 >= llimit) rel_yline(cr, g.x1, g.ybar-4, 8);
-      if (g.x2 <= rlimit) rel_yline(cr, g.x2, g.ybar-4, 8);
-      cr->stroke();
-      cr->set_line_width(3);
-      cr->move_to(std::max(g.x1, llimit), g.ybar);
-      cr->line_to(std::min(g.x2, rlimit), g.ybar);
-      cr->stroke();
+      if (g.x1 >= llimit) edge.yline(cls, g.x1, g.ybar-4, 8);
+      if (g.x2 <= rlimit) edge.yline(cls, g.x2, g.ybar-4, 8);
+      double x1(std::max(g.x1, llimit));
+      body.xline(cls, x1, g.ybar, std::min(g.x2, rlimit) - x1);
 
       // Exon
-      cr->set_line_width(6);
       for (int32_t i=0; i<m.exonCount; ++i) {
 	double x(BP2PIXEL(m.exon[i].start - par.xstart +1));
 	double xlen(std::max(1.0,m.exon[i].getlen() * par.dot_per_bp));
-	if (x >= llimit && x <= rlimit) {
-	  rel_xline(cr, x, g.ybar, xlen);
-	  cr->stroke();
-	}
+	if (x >= llimit && x <= rlimit) exon.xline(cls, x, g.ybar, xlen);
       }
 
       // Name
-      cr->set_source_rgba(CLR_BLACK, 1);
-      if (p.anno.showtranscriptname) showtext_cr(cr, g.x_name, g.y_name, m.tname, 8);
-      else showtext_cr(cr, g.x_name, g.y_name, m.gname, 8);
+      if (p.anno.showtranscriptname) labels.emplace_back(g.x_name, g.y_name, GCLR_BLACK, 8, m.tname);
+      else labels.emplace_back(g.x_name, g.y_name, GCLR_BLACK, 8, m.gname);
     }
-  } catch (...) {
-    std::cerr << "Warning: " << chrname  << " has no gene." << std::endl;
+
+    auto setcolor = [this](const int32_t cls) { setGeneColor(cr, cls); };
+    cr->set_line_width(1.5);
+    edge.stroke(cr, setcolor);
+    cr->set_line_width(3);
+    body.stroke(cr, setcolor);
+    cr->set_line_width(6);
+    exon.stroke(cr, setcolor);
+    showGeneLabels(cr, labels);
   }
 
   DEBUGprint_FUNCend();
@@ -284,7 +317,7 @@ void PDFPage::DrawGeneAnnotation(const DROMPA::Global &p)
 
   if (p.anno.arsfile != "") {
     DEBUGprint("DrawARS");
-    strokeARS(p.anno.arsgmp, ycenter);
+    strokeARS(p.anno.arsindex, ycenter);
   }
   if (p.anno.genefile != "") {
     DEBUGprint("DrawGene");
@@ -7,6 +7,7 @@
 #include <boost/algorithm/string.hpp>
 #include "dd_sample_definition.hpp"
 #include "ReadAnnotation.hpp"
+#include "dd_chiadrop.hpp"
 #include "../submodules/SSP/common/util.hpp"
 #include "../submodules/SSP/common/BoostOptions.hpp"
 
@@ -15,7 +16,7 @@ class chrsize;
 enum class DrompaCommand {
                           CHIP, NORM, THRE, ANNO_PC, ANNO_GV,
                           DRAW, REGION, GENWIG, PROF, MULTICI,
-                          CG, TR, OTHER
+                          CG, TR, SERVE, OTHER
 };
 
 class CommandParamSet {
@@ -106,15 +107,16 @@ namespace DROMPA {
     int32_t gftype;
     HashOfGeneDataMap gmp;
     HashOfGeneDataMap arsgmp;
+    ChrGeneIndex gindex;    // sorted interval index of gmp
+    ChrGeneIndex arsindex;  // sorted interval index of arsgmp
     bool showtranscriptname;
     std::string arsfile;
     std::string terfile;
     std::vector<vbed<bed>> vbedlist;
     std::vector<vbed<bed12>> vbed12list;
     std::vector<InteractionSet> vinterlist;
-    std::vector<cytoband> vcytoband;
-    std::unordered_map<std::string,
-                       std::unordered_map<std::string, std::vector<int32_t>>> mp_ChIADrop;
+    ChrVector<std::vector<cytoband>> vcytoband;
+    ChrVector<ChIADropFragments> mp_ChIADrop;
     int32_t chia_distance_thre;
     std::string repeatfile;
     std::string mpfile;
@@ -140,12 +142,17 @@ namespace DROMPA {
     void setOptsPC(MyOpt::Opts &allopts);
     void setOptsGV(MyOpt::Opts &allopts);
 
-    HashOfGeneDataMap getGMP() {
+    // parsed genes are kept in cachefile (none if empty) and reused while the gene file is unchanged
+    HashOfGeneDataMap getGMP(const std::string &cachefile) {
       HashOfGeneDataMap tmp;
-      if (!gftype)        tmp = parseRefFlat(genefile);
-      else if (gftype==1) tmp = parseGtf(genefile);
-      else if (gftype==2) tmp = parseSGD(genefile);
-      else PRINTERR_AND_EXIT("invalid --gftype: " << gftype);
+      bool usecache(cachefile != "");
+      if (!usecache || !loadGeneCache(cachefile, genefile, gftype, tmp)) {
+        if (!gftype)        tmp = parseRefFlat(genefile);
+        else if (gftype==1) tmp = parseGtf(genefile);
+        else if (gftype==2) tmp = parseSGD(genefile);
+        else PRINTERR_AND_EXIT("invalid --gftype: " << gftype);
+        if (usecache) saveGeneCache(cachefile, genefile, gftype, tmp);
+      }
 
       isUCSC = isGeneUCSC(tmp);
       //      printMap(tmp);
@@ -172,12 +179,13 @@ namespace DROMPA {
     int32_t width_from_center;
     int32_t ptype;
     int32_t stype;
+    int32_t mtype;
     //   int32_t ntype;
 
   public:
 
     Profile(): width_from_center(0),
-               ptype(0), stype(0) {} //, ntype(0)
+               ptype(0), stype(0), mtype(0) {} //, ntype(0)
 
     void setOpts(MyOpt::Opts &allopts);
     void setValues(const MyOpt::Variables &values);
@@ -188,6 +196,7 @@ namespace DROMPA {
     bool isPtypeBed()     const { return ptype == BEDSITES; }
     int32_t get_width_from_center() const { return width_from_center; }
     int32_t is_distribution_type() const { return stype; }
+    bool isBinaryMatrix() const { return mtype == 1; }
 //    int32_t is_normalization_type() const { return ntype; }
   };
 
@@ -213,7 +222,7 @@ namespace DROMPA {
   //// DrawRegion
   class DrawRegion {
     bool isRegion;
-    std::vector<bed> regionBed;
+    ChrVector<std::vector<bed>> regionBed;  // partitioned by chromosome, in input order
 
     std::string chr;
     std::unordered_map<std::string, int32_t> geneloci;
@@ -242,12 +251,8 @@ namespace DROMPA {
     void setValues(const MyOpt::Variables &values);
     void InitDump(const MyOpt::Variables &values) const;
 
-    std::vector<bed> getRegionBedChr(const std::string &chrname) const {
-      std::vector<bed> vbed;
-      for (auto &x: regionBed) {
-        if (x.chr == chrname || x.chr == "chr" + chrname) vbed.emplace_back(x);
-      }
-      return vbed;
+    const std::vector<bed> & getRegionBedChr(const int32_t chrid) const {
+      return regionBed.get(chrid);
     }
     const std::string & getchr() const { return chr; }
     bool isRegionBed() const { return isRegion; }
@@ -269,6 +274,7 @@ namespace DROMPA {
     bool showymem;
     bool showylab;
     bool showpdf;
+    int32_t rendermode;
 
     int32_t samplenum;
 
@@ -287,7 +293,7 @@ namespace DROMPA {
     double alpha;
 
     DrawParam(): linenum_per_page(0), barnum(0), ystep(0),
-                 showymem(true), showylab(true), showpdf(true),
+                 showymem(true), showylab(true), showpdf(true), rendermode(0),
                  samplenum(0),
                  width_page_pixel(0), width_draw_pixel(0), width_per_line(0),
                  showctag(0), showitag(0), showratio(0), showpinter(0), showpenrich(0),
@@ -301,6 +307,7 @@ namespace DROMPA {
     bool isshowymem() const { return showymem; };
     bool isshowylab() const { return showylab; };
     bool isshowpdf() const { return showpdf; };
+    bool isReducedRendering() const { return rendermode == 1; };
 
     int32_t getbarnum() const { return barnum; }
     double getystep() const { return ystep; }
@@ -325,21 +332,28 @@ namespace DROMPA {
   /// Global
   class Global {
     bool ispng;
+    bool usecache;
     bool showchr;
     WigType iftype;
     std::string oprefix;
     bool includeYM;
     int32_t norm;
     int32_t smoothing;
+    int32_t numthreads;
+    std::string paramkey;
 
-    WigType genwig_oftype;
-    int32_t genwig_ofvalue;
+    std::vector<WigType> genwig_oftype;
+    std::vector<int32_t> genwig_ofvalue;
     std::string genometablefilename;
 
     // MULTICI
     bool getmaxval;
     bool addname;
 
+    // SERVE
+    std::string socketpath;
+    int32_t maxchr;
+
   public:
     MyOpt::Opts opts;
     DrawParam drawparam;
@@ -355,9 +369,9 @@ namespace DROMPA {
     bool isGV;
 
     Global():
-      ispng(false), showchr(false), iftype(WigType::NONE),
-      oprefix(""), includeYM(false), norm(0), smoothing(0),
-      genwig_ofvalue(0), getmaxval(false), addname(false),
+      ispng(false), usecache(false), showchr(false), iftype(WigType::NONE),
+      oprefix(""), includeYM(false), norm(0), smoothing(0), numthreads(1),
+      getmaxval(false), addname(false), socketpath(""), maxchr(0),
       opts("Options"), isGV(false)
     {}
 
@@ -367,6 +381,7 @@ namespace DROMPA {
     void setValuesNorm(const MyOpt::Variables &values);
     void setOptsOther(MyOpt::Opts &allopts);
     void setValuesOther(const MyOpt::Variables &values);
+    void setParamKey(const MyOpt::Variables &values);
     void InitDumpChIP() const;
     void InitDumpNorm() const;
     void InitDumpOther() const;
@@ -375,28 +390,48 @@ namespace DROMPA {
 
     int32_t getSmoothing() const { return smoothing; }
     int32_t getChIPInputNormType() const { return norm; }
+    int32_t getNumThreads() const { return numthreads; }
     const std::string getPrefixName() const { return oprefix; }
     const std::string getFigFileName() const { return oprefix + ".pdf"; }
     const std::string getGenomeTableFileName() const { return genometablefilename; }
     const std::string getFigFileNameChr(const std::string &chr) const
     {
+      if (usecache && !showchr) return getCacheFileName(chr, ".pdf");
       return oprefix + "_" + chr + ".pdf";
     }
+    // intermediate files of each chromosome kept for the next run
+    const std::string getCacheDir() const { return oprefix + ".cache"; }
+    const std::string getCacheFileName(const std::string &chr, const std::string &suffix) const
+    {
+      return getCacheDir() + "/" + chr + suffix;
+    }
     const std::string genwig_getOutputFileTypeStr() const {
       std::vector<std::string> strType = {"COMPRESSED WIG", "WIG", "BEDGRAPH", "BIGWIG"};
-      return strType[static_cast<int32_t>(genwig_oftype)];
+      std::vector<std::string> v;
+      for (auto x: genwig_oftype) v.emplace_back(strType[static_cast<int32_t>(x)]);
+      return boost::algorithm::join(v, ", ");
+    }
+    const std::string genwig_getOutputValueStr() const {
+      std::vector<std::string> strValue = {"ChIP/Input enrichment", "P-value (ChIP internal)", "P-value (ChIP/Input enrichment)"};
+      std::vector<std::string> v;
+      for (auto x: genwig_ofvalue) v.emplace_back(strValue[x]);
+      return boost::algorithm::join(v, ", ");
     }
     bool isincludeYM() const { return includeYM; }
     bool isshowchr() const { return showchr; }
+    bool isoutputpng() const { return ispng; }
+    bool isusecache() const { return usecache; }
+    // options and input files (with size and mtime) that affect the figures
+    const std::string & getParamKey() const { return paramkey; }
     bool isgetmaxval() const { return getmaxval; }
     bool isaddname() const { return addname; }
+    const std::string & getSocketPath() const { return socketpath; }
+    int32_t getMaxChr() const { return maxchr; }
 
     void genwig_openfilestream() {
       for (auto &x: samplepair) x.first.genwig_openfilestream(getPrefixName(), genwig_oftype, genwig_ofvalue);
     }
-    void genwig_closefilestream() {
-      for (auto &x: samplepair) x.first.genwig_closefilestream(getGenomeTableFileName());
-    }
+    void genwig_closefilestream();
   };
 }
 
@@ -4,6 +4,8 @@
 #include "dd_gv.hpp"
 #include "dd_readfile.hpp"
 #include "extendBedFormat.hpp"
+#include "dd_outputcache.hpp"
+#include "RunParallel.hpp"
 
 using namespace boost::program_options;
 using namespace MyOpt;
@@ -14,6 +16,28 @@ using namespace DROMPA;
 #define NOTIFY_OVER(type,val,name)      notifier(std::bind(&MyOpt::over<type>, std::placeholders::_1, val, name))
 #define NOTIFY_RANGE(type,min,max,name) notifier(std::bind(&MyOpt::range<type>, std::placeholders::_1, min, max, name))
 
+namespace {
+  // "0,2" -> {0, 2}
+  std::vector<int32_t> parseIntList(const std::string &str, const int32_t min, const int32_t max, const std::string &name)
+  {
+    std::vector<std::string> v;
+    boost::split(v, str, boost::algorithm::is_any_of(","));
+
+    std::vector<int32_t> list;
+    for (auto &x: v) {
+      int32_t n(0);
+      try {
+        n = stoi(x);
+      } catch (const std::exception &e) {
+        PRINTERR_AND_EXIT("invalid value for " << name << ": " << str);
+      }
+      if (n < min || n > max) PRINTERR_AND_EXIT(name << " should be " << min << "-" << max << ": " << str);
+      if (std::find(list.begin(), list.end(), n) == list.end()) list.emplace_back(n);
+    }
+    return list;
+  }
+}
+
 void Annotation::setOptsPC(MyOpt::Opts &allopts)
 {
   MyOpt::Opts opt("Annotation",100);
@@ -61,7 +85,10 @@ void Annotation::setValuesPC(const Variables &values)
     if (values.count("gene")) {
       genefile = getVal<std::string>(values, "gene");
       gftype   = getVal<int32_t>(values, "gftype");
-      gmp = getGMP();
+      std::string cachefile("");
+      // in the cache directory of the output (created when the cache is written), not next to the gene file
+      if (values.count("cache")) cachefile = getVal<std::string>(values, "output") + ".cache/gene.dgene";
+      gmp = getGMP(cachefile);
     }
     if (values.count("ars")) {
       arsfile = getVal<std::string>(values, "ars");
@@ -71,6 +98,8 @@ void Annotation::setValuesPC(const Variables &values)
       terfile = getVal<std::string>(values, "ter");
       parseTER(terfile, arsgmp);
     }
+    gindex   = construct_GeneIndex(gmp);
+    arsindex = construct_GeneIndex(arsgmp);
     showtranscriptname = values.count("showtranscriptname");
     //	printMap(gmp);
     if (values.count("repeat")) repeatfile = getVal<std::string>(values, "repeat");
@@ -114,12 +143,13 @@ void Annotation::setValuesGV(const Variables &values)
         if (lineStr.empty() || lineStr[0] == '#') continue;
         std::vector<std::string> v;
         ParseLine(v, lineStr, '\t');
-        vcytoband.emplace_back(v);
+        cytoband band(v);
+        vcytoband[chrdict().intern(band.chr)].emplace_back(band);
       }
       isIdeogram = true;
     }
-    if (values.count("chiadrop")) parse_ChIADropData(getVal<std::string>(values, "chiadrop"));
     chia_distance_thre = getVal<int32_t>(values, "chia_distance_thre");
+    if (values.count("chiadrop")) parse_ChIADropData(getVal<std::string>(values, "chiadrop"));
 
     if (values.count("mp")) mpfile = getVal<std::string>(values, "mp");
     mpthre = getVal<double>(values, "mpthre");
@@ -175,6 +205,8 @@ void Profile::setOpts(MyOpt::Opts &allopts)
 //    (SETOPT_RANGE("ntype", int32_t, 0, 0, 1),
 //     "Normalization: 0; total read 1; target regions only")
     (SETOPT_OVER("widthfromcenter", int32_t, 2500, 1), "width from the center")
+    (SETOPT_RANGE("matrixformat", int32_t, 0, 0, 1),
+     "Output format of the matrix: 0; TSV, 1; binary (compressed float32, see otherbins/drompa.readmatrix.py)")
     ;
   allopts.add(opt);
 }
@@ -188,6 +220,7 @@ void Profile::setValues(const Variables &values)
     stype = getVal<int32_t>(values, "stype");
  //   ntype = getVal<int32_t>(values, "ntype");
     width_from_center = getVal<int32_t>(values, "widthfromcenter");
+    mtype = getVal<int32_t>(values, "matrixformat");
   } catch (const boost::bad_any_cast& e) {
     PRINTERR_AND_EXIT(e.what());
   }
@@ -200,10 +233,12 @@ void Profile::InitDump() const {
 
   std::vector<std::string> str_ptype = { "TSS", "TTS", "GENE100", "BEDSITES" };
   std::vector<std::string> str_stype = { "ChIP read", "Enrichment ratio", "Enrichment P-value" };
+  std::vector<std::string> str_mtype = { "TSV", "binary" };
 //  std::vector<std::string> str_ntype = { "WHOLE GENOME", "TARGET REGIONS ONLY" };
 
   std::cout << boost::format("   Profile type: %1%\n")  % str_ptype[ptype];
   std::cout << boost::format("   Show type: %1%\n")     % str_stype[stype];
+  std::cout << boost::format("   Matrix format: %1%\n") % str_mtype[mtype];
 //  std::cout << boost::format("   Normalization: %1%\n") % str_ntype[ntype];
 //  std::cout << boost::format("   Width from center: %1%\n") % width_from_center;
 
@@ -278,9 +313,10 @@ void DrawRegion::setValues(const Variables &values)
     if (values.count("chr")) chr = getVal<std::string>(values, "chr");
     if (values.count("region")) {
       isRegion = true;
-      regionBed = parseBed<bed>(getVal<std::string>(values, "region"));
-      if (!regionBed.size()) PRINTERR_AND_EXIT("Error no bed regions in " << getVal<std::string>(values, "region"));
-      //      printBed(regionBed);
+      auto vbed = parseBed<bed>(getVal<std::string>(values, "region"));
+      if (!vbed.size()) PRINTERR_AND_EXIT("Error no bed regions in " << getVal<std::string>(values, "region"));
+      //      printBed(vbed);
+      for (auto &x: vbed) regionBed[x.chrid].emplace_back(x);
     }
     if (values.count("genelocifile")) {
       getGeneLoci(getVal<std::string>(values, "genelocifile"));
@@ -349,12 +385,12 @@ void Global::setOpts(const std::vector<DrompaCommand> &st, const CommandParamSet
       {
         options_description o("GENWIG",100);
         o.add_options()
-          ("outputformat",
-           boost::program_options::value<int32_t>()->default_value(3)->notifier(std::bind(&MyOpt::range<int32_t>, std::placeholders::_1, 0, static_cast<int>(WigType::WIGTYPENUM) -2, "--outputformat")),
-           "Output format\n   0: compressed wig (.wig.gz)\n   1: uncompressed wig (.wig)\n   2: bedGraph (.bedGraph)\n   3: bigWig (.bw)")
-          ("outputvalue",
-           boost::program_options::value<int32_t>()->default_value(0)->notifier(std::bind(&MyOpt::range<int32_t>, std::placeholders::_1, 0, 2, "--outputvalue")),
-           "Output value\n   0: ChIP/Input enrichment\n   1: P-value (ChIP internal)\n   2: P-value (ChIP/Input enrichment)")
+          ("outputformat", value<std::string>()->default_value("3"),
+           "Output format (comma-separated for multiple formats, e.g. 2,3)\n   0: compressed wig (.wig.gz)\n   1: uncompressed wig (.wig)\n   2: bedGraph (.bedGraph)\n   3: bigWig (.bw)")
+          ("outputvalue", value<std::string>()->default_value("0"),
+           "Output value (comma-separated for multiple values, e.g. 0,1,2)\n   0: ChIP/Input enrichment\n   1: P-value (ChIP internal)\n   2: P-value (ChIP/Input enrichment)")
+          ("cache", "keep the output segments of each chromosome in <prefix>.cache/ and reuse them in the next run while the options and input files are unchanged (input files over 64 MB are compared by size and mtime only)")
+          (SETOPT_OVER("threads,p", int32_t, 1, 1), "number of threads to launch")
           ;
         opts.add(o);
         break;
@@ -377,6 +413,16 @@ void Global::setOpts(const std::vector<DrompaCommand> &st, const CommandParamSet
         opts.add(o);
         break;
       }
+    case DrompaCommand::SERVE:
+      {
+        options_description o("SERVE",100);
+        o.add_options()
+          ("socket", value<std::string>(), "Unix domain socket to listen on (default: read requests from stdin)")
+          (SETOPT_OVER("maxchr", int32_t, 3, 1), "Maximum number of chromosomes kept loaded (the least recently requested one is released)")
+          ;
+        opts.add(o);
+        break;
+      }
     case DrompaCommand::OTHER: setOptsOther(opts); break;
     }
   }
@@ -389,6 +435,8 @@ void Global::setValues(const std::vector<DrompaCommand> &vopts, const Variables
   oprefix = getVal<std::string>(values, "output");
   genometablefilename = getVal<std::string>(values, "gt");
   gt = readGenomeTable(genometablefilename);
+  // chromosome IDs follow the order of the genome table
+  for (auto &x: gt) chrdict().intern(x.getname());
 
   for (auto op: vopts) {
     switch(op) {
@@ -442,8 +490,16 @@ void Global::setValues(const std::vector<DrompaCommand> &vopts, const Variables
     case DrompaCommand::GENWIG:
       {
         DEBUGprint("Global::setValues::GENWIG");
-        genwig_oftype = static_cast<WigType>(MyOpt::getVal<int32_t>(values, "outputformat"));
-        genwig_ofvalue = MyOpt::getVal<int32_t>(values, "outputvalue");
+        for (auto x: parseIntList(getVal<std::string>(values, "outputformat"), 0, static_cast<int>(WigType::WIGTYPENUM) -2, "--outputformat")) {
+          genwig_oftype.emplace_back(static_cast<WigType>(x));
+        }
+        genwig_ofvalue = parseIntList(getVal<std::string>(values, "outputvalue"), 0, 2, "--outputvalue");
+        if (std::find(genwig_oftype.begin(), genwig_oftype.end(), WigType::COMPRESSWIG) != genwig_oftype.end()
+            && std::find(genwig_oftype.begin(), genwig_oftype.end(), WigType::UNCOMPRESSWIG) != genwig_oftype.end()) {
+          PRINTERR_AND_EXIT("--outputformat 0 and 1 cannot be specified together.");
+        }
+        usecache = values.count("cache");
+        numthreads = getVal<int32_t>(values, "threads");
         break;
       }
     case DrompaCommand::CG:
@@ -456,9 +512,17 @@ void Global::setValues(const std::vector<DrompaCommand> &vopts, const Variables
         DEBUGprint("Global::setValues::TR");
         break;
       }
+    case DrompaCommand::SERVE:
+      {
+        DEBUGprint("Global::setValues::SERVE");
+        if (values.count("socket")) socketpath = getVal<std::string>(values, "socket");
+        maxchr = getVal<int32_t>(values, "maxchr");
+        break;
+      }
     case DrompaCommand::OTHER: setValuesOther(values); break;
     }
   }
+  setParamKey(values);
 
   return;
 }
@@ -492,6 +556,7 @@ void Global::setOptsOther(MyOpt::Opts &allopts)
     ("includeYM", "output peaks of chromosome Y and M")
     ("showchr",   "Output chromosome-separated pdf files")
     ("png",     "Output with png format (Note: output each page separately)")
+    ("cache", "keep the pdf file and peaks of each chromosome in <prefix>.cache/ and reuse them (and PNG pages) in the next run while the options and input files are unchanged (input files over 64 MB are compared by size and mtime only)")
     (SETOPT_OVER("threads,p", int32_t, 1, 1), "number of threads to launch")
     ("help,h", "show help message")
     ;
@@ -504,13 +569,58 @@ void Global::setValuesOther(const Variables &values)
   try {
     includeYM = values.count("includeYM");
     ispng = values.count("png");
+    usecache = values.count("cache");
     showchr = values.count("showchr");
+    numthreads = getVal<int32_t>(values, "threads");
   } catch(const boost::bad_any_cast& e) {
     PRINTERR_AND_EXIT(e.what());
   }
   DEBUGprint_FUNCend();
 }
 
+void Global::setParamKey(const Variables &values)
+{
+  const std::vector<std::string> ignore = {"output", "threads", "png", "cache", "showchr", "help"};
+  paramkey = "";
+  for (auto &x: values) {
+    if (std::find(ignore.begin(), ignore.end(), x.first) != ignore.end()) continue;
+
+    std::vector<std::string> v;
+    const boost::any &val(x.second.value());
+    if (val.empty())                                        v.emplace_back("");
+    else if (auto p = boost::any_cast<int32_t>(&val))      v.emplace_back(std::to_string(*p));
+    else if (auto p = boost::any_cast<double>(&val))       v.emplace_back(std::to_string(*p));
+    else if (auto p = boost::any_cast<std::string>(&val))  v.emplace_back(*p);
+    else if (auto p = boost::any_cast<std::vector<std::string>>(&val)) v = *p;
+
+    paramkey += x.first + "=";
+    for (auto &str: v) {
+      paramkey += str + ";";
+      // files given in the option value ("<file>,<label>,...")
+      std::vector<std::string> files;
+      boost::split(files, str, boost::algorithm::is_any_of(","));
+      for (auto &file: files) {
+        if (file != "") {
+          std::string filekey(OutputCache::getFileKey(file));
+          if (filekey != "") paramkey += file + ":" + filekey + ";";
+        }
+      }
+    }
+    paramkey += "\t";
+  }
+}
+
+// sorting bedGraph and converting to bigWig are run in parallel
+void Global::genwig_closefilestream()
+{
+  std::vector<GenwigFile *> vfile;
+  for (auto &x: samplepair) {
+    for (auto &f: x.first.getGenwigFiles()) vfile.emplace_back(&f);
+  }
+
+  runParallel(numthreads, vfile.size(), [&] (const size_t i) { vfile[i]->close(genometablefilename); });
+}
+
 void Global::InitDumpChIP() const {
   DEBUGprint_FUNCStart();
 
@@ -539,9 +649,12 @@ void Global::InitDumpOther() const {
   DEBUGprint_FUNCStart();
 
   std::vector<std::string> str_format = {"PDF", "PNG"};
-  if (drawparam.isshowpdf()) std::cout << boost::format("   Output format: %1%\n") % str_format[ispng];
-  else std::cout << boost::format("   Output format: do not depict figure files.\n");
+  if (drawparam.isshowpdf()) {
+    std::cout << boost::format("   Output format: %1%\n") % str_format[ispng];
+  } else std::cout << boost::format("   Output format: do not depict figure files.\n");
   if (includeYM) std::cout << boost::format("   include chromosome Y and M\n");
+  if (usecache) std::cout << boost::format("   reuse unchanged outputs in %1%\n") % getCacheDir();
+  std::cout << boost::format("   Number of threads: %1%\n") % numthreads;
   DEBUGprint_FUNCend();
 }
 
@@ -564,6 +677,8 @@ void DrawParam::setOpts(MyOpt::Opts &allopts, const CommandParamSet &cps)
     (SETOPT_OVER("width_page", int32_t, 1088, 1), "Width(pixel) of pdf page")
     (SETOPT_OVER("width_draw", int32_t, 750, 1), "Width(pixel) of read line")
     (SETOPT_RANGE("alpha", double, 1,  0, 1), "Transparency of read distribution")
+    (SETOPT_RANGE("rendermode", int32_t, 0, 0, 1),
+     "Rendering of read distribution\n     0: draw each bin\n     1: reduce bins to the pixel columns of the page (smaller and faster PDF)")
     ("shownegative", "allow negative values in historgram")
     ("offymem", "Omit Y memory")
     ("offylabel", "Omit Y label")
@@ -593,6 +708,7 @@ void DrawParam::setValues(const Variables &values, const int32_t n)
     showylab = !values.count("offylabel");
     showpdf  = !values.count("offpdf");
     alpha = getVal<double>(values, "alpha");
+    rendermode = getVal<int32_t>(values, "rendermode");
 
     scale_tag    = getVal<double>(values, "scale_tag");
     scale_ratio  = getVal<double>(values, "scale_ratio");
@@ -611,6 +727,7 @@ void DrawParam::InitDump() const {
   std::vector<std::string> str_bool = {"OFF", "ON"};
   std::vector<std::string> str_input = {"OFF", "ALL", "FIRST"};
   std::vector<std::string> str_ratio = {"OFF", "Linear", "Logratio"};
+  std::vector<std::string> str_render = {"each bin", "reduced to pixel columns"};
 
   std::cout << boost::format("\nFigure parameter:\n");
   std::cout << boost::format("   Display read: ChIP %1%, Input %2%, y-axis scale: %3%\n") % str_bool[showctag] % str_input[showitag] % scale_tag;
@@ -620,6 +737,7 @@ void DrawParam::InitDump() const {
   std::cout << boost::format("   Width per line: %1% kbp\n")           % (width_per_line/1000);
   std::cout << boost::format("   Y-axis label: %1%\n")                 % str_bool[showylab];
   std::cout << boost::format("   Y-axis memory: %1%\n")                % str_bool[showymem];
+  std::cout << boost::format("   Rendering: %1%\n")                    % str_render[rendermode];
 
   DEBUGprint("barnum " << barnum);
   DEBUGprint("ystep " << ystep);
@@ -0,0 +1,75 @@
+/* Copyright(c) Ryuichiro Nakato <rnakato@iam.u-tokyo.ac.jp>
+ * All rights reserved.
+ */
+#ifndef _DD_OUTPUTCACHE_H_
+#define _DD_OUTPUTCACHE_H_
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <unordered_map>
+#include <boost/format.hpp>
+#include <sys/stat.h>
+
+/* Keys of the files written by previous runs (PNG pages in <prefix>.tilecache.tsv,
+ * chromosome outputs in <prefix>.cache/manifest.tsv).
+ * A file is reused when it exists and was written with the same key. */
+class OutputCache {
+  std::string filename;
+  std::unordered_map<std::string, std::string> entries;
+
+public:
+  explicit OutputCache(const std::string &f): filename(f) {
+    std::ifstream in(filename);
+    std::string lineStr;
+    while (getline(in, lineStr)) {
+      size_t p(lineStr.rfind('\t'));
+      if (p != std::string::npos) entries[lineStr.substr(0, p)] = lineStr.substr(p+1);
+    }
+  }
+
+  // FNV-1a, stable between runs
+  static std::string getKey(const std::string &str) {
+    uint64_t h(14695981039346656037ULL);
+    for (auto c: str) {
+      h ^= static_cast<uint8_t>(c);
+      h *= 1099511628211ULL;
+    }
+    return (boost::format("%016x") % h).str();
+  }
+
+  /* key of an input file: the hash of its contents, or its size and mtime if it is larger than
+     maxHashedFileSize (sample data), so a same-size rewrite of a large file within a second is not noticed.
+     Empty if the file does not exist. */
+  static std::string getFileKey(const std::string &file) {
+    const int64_t maxHashedFileSize(64 * 1024 * 1024);
+    struct stat st;
+    if (stat(file.c_str(), &st) || !S_ISREG(st.st_mode)) return "";
+    if (st.st_size > maxHashedFileSize) return (boost::format("%1%:%2%") % st.st_size % st.st_mtime).str();
+
+    std::ifstream in(file, std::ios::binary);
+    std::string data(st.st_size, '\0');
+    in.read(&data[0], st.st_size);
+    return getKey(data);
+  }
+
+  bool isUpToDate(const std::string &file, const std::string &key) const {
+    auto itr = entries.find(file);
+    struct stat st;
+    return itr != entries.end() && itr->second == key && !stat(file.c_str(), &st);
+  }
+  bool isUpToDate(const std::vector<std::string> &files, const std::string &key) const {
+    for (auto &x: files) {
+      if (!isUpToDate(x, key)) return false;
+    }
+    return true;
+  }
+  void set(const std::string &file, const std::string &key) { entries[file] = key; }
+
+  void save() const {
+    std::ofstream out(filename);
+    for (auto &x: entries) out << x.first << "\t" << x.second << "\n";
+  }
+};
+
+#endif /* _DD_OUTPUTCACHE_H_ */
@@ -0,0 +1,620 @@
+/* Copyright(c) Ryuichiro Nakato <rnakato@iam.u-tokyo.ac.jp>
+ * All rights reserved.
+ */
+#include <fstream>
+#include <map>
+#include <set>
+#include <deque>
+#include <cstring>
+#include <zlib.h>
+#include <boost/format.hpp>
+#include "dd_pdfmerge.hpp"
+#include "../submodules/SSP/common/inline.hpp"
+
+namespace {
+  bool isPdfSpace(const char c) {
+    return c==' ' || c=='\n' || c=='\r' || c=='\t' || c=='\f' || c=='\0';
+  }
+  bool isPdfDelimiter(const char c) {
+    return c && strchr("()<>[]{}/%", c);
+  }
+  bool isPdfRegular(const char c) {
+    return !isPdfSpace(c) && !isPdfDelimiter(c);
+  }
+  bool isDigit(const char c) { return c >= '0' && c <= '9'; }
+
+  class PdfObject {
+  public:
+    enum Type {NUL, NUMBER, NAME, STRING, ARRAY, DICT, REF, KEYWORD};
+    Type type;
+    double num;
+    int64_t ref;
+    std::string str;
+    std::vector<PdfObject> array;
+    std::map<std::string, PdfObject> dict;
+
+    PdfObject(): type(NUL), num(0), ref(0) {}
+
+    const PdfObject * get(const std::string &key) const {
+      auto itr = dict.find(key);
+      return itr == dict.end() ? nullptr : &itr->second;
+    }
+    bool isName(const std::string &s) const { return type == NAME && str == s; }
+  };
+
+  // end of the literal string starting at buf[i] == '('
+  size_t skipLiteralString(const std::string &buf, size_t i) {
+    int32_t depth(0);
+    for (; i<buf.size(); ++i) {
+      if (buf[i] == '\\') ++i;
+      else if (buf[i] == '(') ++depth;
+      else if (buf[i] == ')' && !--depth) return i+1;
+    }
+    return buf.size();
+  }
+
+  class PdfParser {
+    const std::string &buf;
+    const std::string &name;
+
+    std::string readToken() {
+      size_t s(pos);
+      while (pos < buf.size() && isPdfRegular(buf[pos])) ++pos;
+      return buf.substr(s, pos-s);
+    }
+    bool isInteger(const std::string &token) const {
+      if (token.empty()) return false;
+      for (auto c: token) if (!isDigit(c)) return false;
+      return true;
+    }
+
+  public:
+    size_t pos;
+
+    PdfParser(const std::string &b, const size_t p, const std::string &n):
+      buf(b), name(n), pos(p)
+    {}
+
+    void skipSpace() {
+      while (pos < buf.size()) {
+        if (isPdfSpace(buf[pos])) ++pos;
+        else if (buf[pos] == '%') {
+          while (pos < buf.size() && buf[pos] != '\n' && buf[pos] != '\r') ++pos;
+        } else break;
+      }
+    }
+    bool isKeyword(const std::string &kw) {
+      skipSpace();
+      if (buf.compare(pos, kw.size(), kw)) return false;
+      if (pos + kw.size() < buf.size() && isPdfRegular(buf[pos + kw.size()])) return false;
+      pos += kw.size();
+      return true;
+    }
+
+    PdfObject parse() {
+      skipSpace();
+      if (pos >= buf.size()) PRINTERR_AND_EXIT(name << ": unexpected end of PDF data.");
+
+      PdfObject obj;
+      char c(buf[pos]);
+      if (c == '/') {
+        ++pos;
+        obj.type = PdfObject::NAME;
+        obj.str = readToken();
+      } else if (c == '(') {
+        size_t e(skipLiteralString(buf, pos));
+        obj.type = PdfObject::STRING;
+        obj.str = buf.substr(pos, e-pos);
+        pos = e;
+      } else if (c == '<' && pos+1 < buf.size() && buf[pos+1] == '<') {
+        pos += 2;
+        obj.type = PdfObject::DICT;
+        while (1) {
+          skipSpace();
+          if (pos+1 >= buf.size()) PRINTERR_AND_EXIT(name << ": unterminated dictionary.");
+          if (buf[pos] == '>' && buf[pos+1] == '>') {
+            pos += 2;
+            break;
+          }
+          PdfObject key(parse());
+          if (key.type != PdfObject::NAME) PRINTERR_AND_EXIT(name << ": invalid dictionary key.");
+          obj.dict[key.str] = parse();
+        }
+      } else if (c == '<') {
+        size_t e(buf.find('>', pos));
+        if (e == std::string::npos) PRINTERR_AND_EXIT(name << ": unterminated hex string.");
+        obj.type = PdfObject::STRING;
+        obj.str = buf.substr(pos, e+1-pos);
+        pos = e+1;
+      } else if (c == '[') {
+        ++pos;
+        obj.type = PdfObject::ARRAY;
+        while (1) {
+          skipSpace();
+          if (pos >= buf.size()) PRINTERR_AND_EXIT(name << ": unterminated array.");
+          if (buf[pos] == ']') {
+            ++pos;
+            break;
+          }
+          obj.array.emplace_back(parse());
+        }
+      } else if (isPdfRegular(c)) {
+        std::string token(readToken());
+        if (isInteger(token)) {
+          // "num gen R"
+          size_t p(pos);
+          skipSpace();
+          std::string gen(readToken());
+          skipSpace();
+          if (isInteger(gen) && isKeyword("R")) {
+            obj.type = PdfObject::REF;
+            obj.ref = stoll(token);
+            return obj;
+          }
+          pos = p;
+        }
+        if (isDigit(c) || c == '+' || c == '-' || c == '.') {
+          obj.type = PdfObject::NUMBER;
+          obj.num = atof(token.c_str());
+        } else {
+          obj.type = PdfObject::KEYWORD;
+          obj.str = token;
+        }
+      } else {
+        PRINTERR_AND_EXIT(name << ": unexpected character '" << c << "' at " << pos << ".");
+      }
+      return obj;
+    }
+  };
+
+  /* Replace each "num gen R" in text with func(num).
+   * Strings, names and comments are copied as they are. */
+  template <class Func>
+  std::string replaceRefs(const std::string &text, Func func)
+  {
+    std::string out;
+    out.reserve(text.size());
+    size_t i(0), n(text.size());
+    while (i < n) {
+      char c(text[i]);
+      size_t j(i+1);
+      if (c == '(') {
+        j = skipLiteralString(text, i);
+      } else if (c == '%') {
+        while (j < n && text[j] != '\n' && text[j] != '\r') ++j;
+      } else if (c == '<') {
+        if (j < n && text[j] == '<') ++j;  // dictionary
+        else {
+          j = text.find('>', i);
+          j = (j == std::string::npos) ? n : j+1;
+        }
+      } else if (c == '/') {
+        while (j < n && isPdfRegular(text[j])) ++j;
+      } else if (isDigit(c)) {
+        while (j < n && isDigit(text[j])) ++j;
+        if (j == n || !isPdfRegular(text[j])) {
+          size_t k(j);
+          while (k < n && isPdfSpace(text[k])) ++k;
+          size_t g(k);
+          while (k < n && isDigit(text[k])) ++k;
+          if (k > g && k < n && isPdfSpace(text[k])) {
+            while (k < n && isPdfSpace(text[k])) ++k;
+            if (k < n && text[k] == 'R' && (k+1 == n || !isPdfRegular(text[k+1]))) {
+              out += func(stoll(text.substr(i, j-i)));
+              i = k+1;
+              continue;
+            }
+          }
+        } else {
+          while (j < n && isPdfRegular(text[j])) ++j;
+        }
+      } else if (isPdfRegular(c)) {
+        while (j < n && isPdfRegular(text[j])) ++j;
+      }
+      out.append(text, i, j-i);
+      i = j;
+    }
+    return out;
+  }
+
+  std::string inflateData(const std::string &in, const std::string &name)
+  {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit(&zs) != Z_OK) PRINTERR_AND_EXIT("inflateInit failed.");
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+    zs.avail_in = in.size();
+
+    std::string out;
+    char buf[65536];
+    int32_t ret;
+    do {
+      zs.next_out = reinterpret_cast<Bytef *>(buf);
+      zs.avail_out = sizeof(buf);
+      ret = inflate(&zs, Z_NO_FLUSH);
+      if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+        inflateEnd(&zs);
+        PRINTERR_AND_EXIT(name << ": broken compressed stream.");
+      }
+      out.append(buf, sizeof(buf) - zs.avail_out);
+    } while (ret == Z_OK);
+    inflateEnd(&zs);
+    return out;
+  }
+
+  // PNG predictors (10-15) used by xref streams
+  std::string unpredictPNG(const std::string &in, const int32_t columns, const int32_t bpp)
+  {
+    std::string out;
+    std::vector<uint8_t> prev(columns, 0), row(columns);
+    size_t rowlen(columns + 1);
+    for (size_t r=0; r + rowlen <= in.size(); r += rowlen) {
+      int32_t type(static_cast<uint8_t>(in[r]));
+      for (int32_t i=0; i<columns; ++i) {
+        uint8_t x(in[r+1+i]);
+        int32_t a(i >= bpp ? row[i-bpp] : 0);
+        int32_t b(prev[i]);
+        int32_t c(i >= bpp ? prev[i-bpp] : 0);
+        switch (type) {
+        case 1: x += a; break;
+        case 2: x += b; break;
+        case 3: x += (a + b) / 2; break;
+        case 4: {
+          int32_t p(a + b - c), pa(abs(p - a)), pb(abs(p - b)), pc(abs(p - c));
+          x += (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+          break;
+        }
+        default: break;
+        }
+        row[i] = x;
+      }
+      out.append(row.begin(), row.end());
+      prev.swap(row);
+    }
+    return out;
+  }
+
+  class PdfFile {
+    class XrefEntry {
+    public:
+      int32_t type;     // 0: free, 1: in file, 2: in object stream
+      int64_t offset;   // offset in file, or number of the object stream
+      int64_t index;    // index in the object stream
+      XrefEntry(const int32_t t=0, const int64_t o=0, const int64_t i=0): type(t), offset(o), index(i) {}
+    };
+
+    std::string data;
+    std::map<int64_t, XrefEntry> xref;
+    std::map<std::pair<int64_t, int64_t>, std::string> objstm;
+    std::set<int64_t> loadedobjstm;
+
+    void addXref(const int64_t num, const XrefEntry &e) {
+      if (!xref.count(num)) xref[num] = e;  // newer sections are read first
+    }
+
+    int64_t readXrefTable(PdfParser &ps);
+    int64_t readXrefStream(const int64_t offset);
+    std::string decodeStream(const PdfObject &dict, const std::string &stream) const;
+    void loadObjStm(const int64_t stmnum);
+
+  public:
+    std::string filename;
+    std::string version;
+    PdfObject trailer;
+
+    class RawObject {
+    public:
+      PdfObject value;
+      std::string text;
+      std::string stream;
+      bool isstream;
+      RawObject(): text("null"), isstream(false) {}
+    };
+
+    explicit PdfFile(const std::string &f): filename(f), version("1.4") {
+      std::ifstream in(filename, std::ios::binary);
+      if (!in) PRINTERR_AND_EXIT("cannot open " << filename);
+      in.seekg(0, std::ios::end);
+      data.resize(in.tellg());
+      in.seekg(0);
+      in.read(&data[0], data.size());
+
+      if (data.compare(0, 5, "%PDF-")) PRINTERR_AND_EXIT(filename << " is not a PDF file.");
+      version = data.substr(5, 3);
+      readXref();
+      if (trailer.get("Encrypt")) PRINTERR_AND_EXIT(filename << ": encrypted PDF is not supported.");
+    }
+
+    void readXref();
+    bool exists(const int64_t num) const {
+      auto itr = xref.find(num);
+      return itr != xref.end() && itr->second.type;
+    }
+    RawObject readObjectAt(const size_t offset);
+    RawObject getObject(const int64_t num);
+    int64_t getRef(const PdfObject &dict, const std::string &key) const {
+      const PdfObject *obj(dict.get(key));
+      if (!obj || obj->type != PdfObject::REF) PRINTERR_AND_EXIT(filename << ": /" << key << " not found.");
+      return obj->ref;
+    }
+  };
+
+  void PdfFile::readXref()
+  {
+    size_t p(data.rfind("startxref"));
+    if (p == std::string::npos) PRINTERR_AND_EXIT(filename << ": startxref not found.");
+    PdfParser ps(data, p + 9, filename);
+    int64_t offset(ps.parse().num);
+
+    std::set<int64_t> visited;
+    while (offset > 0 && offset < static_cast<int64_t>(data.size()) && !visited.count(offset)) {
+      visited.insert(offset);
+      PdfParser ps(data, offset, filename);
+      if (ps.isKeyword("xref")) offset = readXrefTable(ps);
+      else                      offset = readXrefStream(offset);
+    }
+    if (!trailer.get("Root")) PRINTERR_AND_EXIT(filename << ": /Root not found.");
+  }
+
+  int64_t PdfFile::readXrefTable(PdfParser &ps)
+  {
+    while (!ps.isKeyword("trailer")) {
+      int64_t start(ps.parse().num);
+      int64_t count(ps.parse().num);
+      for (int64_t i=0; i<count; ++i) {
+        int64_t offset(ps.parse().num);
+        ps.parse();  // generation
+        PdfObject kw(ps.parse());
+        addXref(start + i, XrefEntry(kw.str == "n" ? 1 : 0, offset));
+      }
+    }
+    PdfObject dict(ps.parse());
+    if (trailer.type == PdfObject::NUL) trailer = dict;
+
+    // hybrid-reference file
+    const PdfObject *stm(dict.get("XRefStm"));
+    if (stm) readXrefStream(stm->num);
+
+    const PdfObject *prev(dict.get("Prev"));
+    return prev ? prev->num : -1;
+  }
+
+  int64_t PdfFile::readXrefStream(const int64_t offset)
+  {
+    RawObject raw(readObjectAt(offset));
+    const PdfObject &dict(raw.value);
+    const PdfObject *type(dict.get("Type"));
+    if (!raw.isstream || !type || !type->isName("XRef")) PRINTERR_AND_EXIT(filename << ": invalid xref at " << offset << ".");
+    if (trailer.type == PdfObject::NUL) trailer = dict;
+
+    const PdfObject *w(dict.get("W"));
+    if (!w || w->array.size() != 3) PRINTERR_AND_EXIT(filename << ": invalid /W in xref stream.");
+    int32_t w1(w->array[0].num), w2(w->array[1].num), w3(w->array[2].num);
+
+    std::vector<int64_t> index;
+    const PdfObject *idx(dict.get("Index"));
+    if (idx) for (auto &x: idx->array) index.emplace_back(x.num);
+    else {
+      const PdfObject *size(dict.get("Size"));
+      if (!size) PRINTERR_AND_EXIT(filename << ": no /Size in xref stream.");
+      index = {0, static_cast<int64_t>(size->num)};
+    }
+
+    std::string table(decodeStream(dict, raw.stream));
+    auto readField = [&table] (size_t &p, const int32_t width) {
+      int64_t v(0);
+      for (int32_t i=0; i<width; ++i) v = (v << 8) | static_cast<uint8_t>(table[p++]);
+      return v;
+    };
+
+    size_t p(0), entrylen(w1 + w2 + w3);
+    for (size_t i=0; i+1 < index.size(); i += 2) {
+      for (int64_t k=0; k<index[i+1] && p + entrylen <= table.size(); ++k) {
+        int32_t t(w1 ? readField(p, w1) : 1);
+        int64_t f2(readField(p, w2));
+        int64_t f3(readField(p, w3));
+        addXref(index[i] + k, XrefEntry(t == 1 || t == 2 ? t : 0, f2, f3));
+      }
+    }
+
+    const PdfObject *prev(dict.get("Prev"));
+    return prev ? prev->num : -1;
+  }
+
+  std::string PdfFile::decodeStream(const PdfObject &dict, const std::string &stream) const
+  {
+    const PdfObject *filter(dict.get("Filter"));
+    if (!filter) return stream;
+    if (filter->type == PdfObject::ARRAY && filter->array.size() == 1) filter = &filter->array[0];
+    if (!filter->isName("FlateDecode")) PRINTERR_AND_EXIT(filename << ": unsupported stream filter.");
+
+    std::string decoded(inflateData(stream, filename));
+
+    const PdfObject *parms(dict.get("DecodeParms"));
+    if (parms && parms->type == PdfObject::ARRAY && parms->array.size() == 1) parms = &parms->array[0];
+    if (!parms || parms->type != PdfObject::DICT) return decoded;
+
+    const PdfObject *predictor(parms->get("Predictor"));
+    if (!predictor || predictor->num == 1) return decoded;
+    if (predictor->num < 10) PRINTERR_AND_EXIT(filename << ": unsupported predictor.");
+    const PdfObject *columns(parms->get("Columns"));
+    const PdfObject *colors(parms->get("Colors"));
+    return unpredictPNG(decoded, columns ? columns->num : 1, colors ? colors->num : 1);
+  }
+
+  PdfFile::RawObject PdfFile::readObjectAt(const size_t offset)
+  {
+    RawObject raw;
+    PdfParser ps(data, offset, filename);
+    ps.parse();
+    ps.parse();
+    if (!ps.isKeyword("obj")) PRINTERR_AND_EXIT(filename << ": object not found at " << offset << ".");
+
+    ps.skipSpace();
+    size_t start(ps.pos);
+    raw.value = ps.parse();
+    raw.text = data.substr(start, ps.pos - start);
+
+    if (!ps.isKeyword("stream")) return raw;
+    size_t s(ps.pos);
+    if (s < data.size() && data[s] == '\r') ++s;
+    if (s < data.size() && data[s] == '\n') ++s;
+
+    int64_t length(-1);
+    const PdfObject *len(raw.value.get("Length"));
+    if (len && len->type == PdfObject::NUMBER) length = len->num;
+    else if (len && len->type == PdfObject::REF) length = getObject(len->ref).value.num;
+
+    // check /Length against endstream
+    PdfParser check(data, s + std::max(length, static_cast<int64_t>(0)), filename);
+    if (length < 0 || s + length > data.size() || !check.isKeyword("endstream")) {
+      size_t e(data.find("endstream", s));
+      if (e == std::string::npos) PRINTERR_AND_EXIT(filename << ": endstream not found.");
+      if (e > s && data[e-1] == '\n') --e;
+      if (e > s && data[e-1] == '\r') --e;
+      length = e - s;
+    }
+    raw.stream = data.substr(s, length);
+    raw.isstream = true;
+    return raw;
+  }
+
+  void PdfFile::loadObjStm(const int64_t stmnum)
+  {
+    if (loadedobjstm.count(stmnum)) return;
+    loadedobjstm.insert(stmnum);
+
+    RawObject raw(getObject(stmnum));
+    if (!raw.isstream) PRINTERR_AND_EXIT(filename << ": invalid object stream " << stmnum << ".");
+    std::string content(decodeStream(raw.value, raw.stream));
+    const PdfObject *pn(raw.value.get("N")), *pfirst(raw.value.get("First"));
+    if (!pn || !pfirst) PRINTERR_AND_EXIT(filename << ": no /N or /First in object stream " << stmnum << ".");
+    int64_t n(pn->num);
+    size_t first(pfirst->num);
+
+    std::vector<std::pair<int64_t, size_t>> header;
+    PdfParser ps(content, 0, filename);
+    for (int64_t i=0; i<n; ++i) {
+      int64_t num(ps.parse().num);
+      size_t off(ps.parse().num);
+      header.emplace_back(num, first + off);
+    }
+    for (int64_t i=0; i<n; ++i) {
+      size_t s(header[i].second);
+      size_t e(i+1 < n ? header[i+1].second : content.size());
+      if (s > content.size() || e < s) PRINTERR_AND_EXIT(filename << ": broken object stream " << stmnum << ".");
+      objstm[std::make_pair(stmnum, i)] = content.substr(s, e-s);
+    }
+  }
+
+  PdfFile::RawObject PdfFile::getObject(const int64_t num)
+  {
+    auto itr = xref.find(num);
+    if (itr == xref.end() || !itr->second.type) return RawObject();
+
+    const XrefEntry &e(itr->second);
+    if (e.type == 1) return readObjectAt(e.offset);
+
+    loadObjStm(e.offset);
+    auto obj = objstm.find(std::make_pair(e.offset, e.index));
+    if (obj == objstm.end()) return RawObject();
+
+    RawObject raw;
+    PdfParser ps(obj->second, 0, filename);
+    ps.skipSpace();
+    size_t start(ps.pos);
+    raw.value = ps.parse();
+    raw.text = obj->second.substr(start, ps.pos - start);
+    return raw;
+  }
+
+  class PdfWriter {
+    std::ofstream out;
+    std::vector<int64_t> offsets;
+
+  public:
+    explicit PdfWriter(const std::string &filename): out(filename, std::ios::binary), offsets(1, 0) {
+      if (!out) PRINTERR_AND_EXIT("cannot open " << filename);
+    }
+
+    void writeHeader(const std::string &version) {
+      out << "%PDF-" << version << "\n%\xe2\xe3\xcf\xd3\n";
+    }
+    int64_t reserve() {
+      offsets.emplace_back(0);
+      return offsets.size() -1;
+    }
+    void writeObject(const int64_t num, const std::string &text, const std::string *stream=nullptr) {
+      offsets[num] = out.tellp();
+      out << num << " 0 obj\n" << text << "\n";
+      if (stream) {
+        out << "stream\n";
+        out.write(stream->data(), stream->size());
+        out << "\nendstream\n";
+      }
+      out << "endobj\n";
+    }
+    void writeTrailer(const int64_t root) {
+      int64_t startxref(out.tellp());
+      out << "xref\n0 " << offsets.size() << "\n0000000000 65535 f \n";
+      for (size_t i=1; i<offsets.size(); ++i) out << boost::format("%010d 00000 n \n") % offsets[i];
+      out << "trailer\n<< /Size " << offsets.size() << " /Root " << root << " 0 R >>\n"
+          << "startxref\n" << startxref << "\n%%EOF\n";
+    }
+  };
+}
+
+void mergePdfFiles(const std::vector<std::string> &infiles, const std::string &outfile)
+{
+  std::string version("1.4");
+  for (auto &x: infiles) {
+    std::ifstream in(x, std::ios::binary);
+    char head[8] = {0};
+    in.read(head, sizeof(head));
+    if (!strncmp(head, "%PDF-", 5) && version < std::string(head+5, 3)) version = std::string(head+5, 3);
+  }
+
+  PdfWriter writer(outfile);
+  writer.writeHeader(version);
+  int64_t catalog(writer.reserve());
+  int64_t pagetree(writer.reserve());
+
+  std::string kids;
+  int64_t count(0);
+  for (auto &filename: infiles) {
+    PdfFile pdf(filename);
+    int64_t root(pdf.getRef(pdf.trailer, "Root"));
+    int64_t pages(pdf.getRef(pdf.getObject(root).value, "Pages"));
+
+    // copy the objects reachable from the page tree with new numbers
+    std::map<int64_t, int64_t> newnum;
+    std::deque<int64_t> queue;
+    auto renumber = [&] (const int64_t num) {
+      auto itr = newnum.find(num);
+      if (itr != newnum.end()) return std::to_string(itr->second) + " 0 R";
+      if (!pdf.exists(num)) return std::string("null");
+      newnum[num] = writer.reserve();
+      queue.emplace_back(num);
+      return std::to_string(newnum[num]) + " 0 R";
+    };
+
+    kids += renumber(pages) + " ";
+    while (!queue.empty()) {
+      int64_t num(queue.front());
+      queue.pop_front();
+      PdfFile::RawObject raw(pdf.getObject(num));
+      std::string text(replaceRefs(raw.text, renumber));
+      if (num == pages) {
+        const PdfObject *c(raw.value.get("Count"));
+        if (raw.value.type != PdfObject::DICT || !c) PRINTERR_AND_EXIT(filename << ": invalid page tree.");
+        count += c->num;
+        text.insert(2, " /Parent " + std::to_string(pagetree) + " 0 R");
+      }
+      writer.writeObject(newnum[num], text, raw.isstream ? &raw.stream : nullptr);
+    }
+  }
+
+  writer.writeObject(pagetree, "<< /Type /Pages /Kids [ " + kids + "] /Count " + std::to_string(count) + " >>");
+  writer.writeObject(catalog, "<< /Type /Catalog /Pages " + std::to_string(pagetree) + " 0 R >>");
+  writer.writeTrailer(catalog);
+}
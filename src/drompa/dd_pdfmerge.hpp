@@ -0,0 +1,15 @@
+/* Copyright(c) Ryuichiro Nakato <rnakato@iam.u-tokyo.ac.jp>
+ * All rights reserved.
+ */
+#ifndef _DD_PDFMERGE_H_
+#define _DD_PDFMERGE_H_
+
+#include <string>
+#include <vector>
+
+/* Concatenate the pages of PDF files (in the given order) into outfile.
+ * Only the page trees are kept; outlines and document info of the inputs are dropped.
+ * Both classic xref tables and xref/object streams (PDF 1.5) are supported. */
+void mergePdfFiles(const std::vector<std::string> &infiles, const std::string &outfile);
+
+#endif /* _DD_PDFMERGE_H_ */
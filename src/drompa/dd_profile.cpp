@@ -1,72 +1,241 @@
 /* Copyright(c)  Ryuichiro Nakato <rnakato@iam.u-tokyo.ac.jp>
  * All rights reserved.
  */
+#include <zlib.h>
 #include "dd_profile.hpp"
+#include "dd_draw_myfunc.hpp"
 #include "color.hpp"
 
 namespace {
-  double getReadVal(const vChrArray &vReadArray, const SamplePairOverlayed &pair,
-                    const int32_t i, const int32_t stype)
+  double getTickInterval(const double range)
   {
-    double val(0);
-    if (!stype) { // ChIP read
-      val = vReadArray.getArray(pair.first.argvChIP).array[i];
-    } else if (stype == 1) { // ChIP/Input enrichment
-      val = getratio(vReadArray.getArray(pair.first.argvChIP).array[i],
-                     vReadArray.getArray(pair.first.argvInput).array[i]);
+    if (range <= 0) return 1;
+    double raw(range / 5);
+    double mag(pow(10, floor(log10(raw))));
+    double norm(raw / mag);
+    if (norm < 1.5)    return mag;
+    else if (norm < 3) return 2 * mag;
+    else if (norm < 7) return 5 * mag;
+    else               return 10 * mag;
+  }
+
+  std::string getTickLabel(const double val)
+  {
+    std::ostringstream oss;
+    oss << val;
+    return oss.str();
+  }
+
+  /* append val as "%g" does (6 significant digits) without going through printf
+     for the usual range of read densities */
+  void appendValue(std::string &str, const double val)
+  {
+    static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+    static const int64_t ipow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+
+    if (val == 0) {
+      str += '0';
+      return;
+    }
+    double a(fabs(val));
+    if (!(a >= 1e-4 && a < 1e5)) {
+      char tmp[32];
+      snprintf(tmp, sizeof(tmp), "%g", val);
+      str += tmp;
+      return;
+    }
+
+    // round a * 10^n to nearest, ties judged by the exact product as printf does
+    auto scale = [&a](const double p) {
+      double t(a * p);
+      int64_t n(floor(t));
+      double diff(t - n);
+      if (diff > 0.5) ++n;
+      else if (diff == 0.5) {
+        double err(fma(a, p, -t));
+        if (err > 0 || (err == 0 && (n & 1))) ++n;
+      }
+      return n;
+    };
+
+    int32_t ndigit(0);  // number of decimal places
+    while (ndigit < 9 && a * pow10[ndigit] < 1e5) ++ndigit;
+    int64_t scaled(scale(pow10[ndigit]));
+    if (scaled >= 1000000) scaled = scale(pow10[--ndigit]);
+
+    int64_t intpart(scaled / ipow10[ndigit]);
+    int64_t frac(scaled % ipow10[ndigit]);
+
+    char tmp[32];
+    int32_t len(0);
+    if (frac) {
+      while (!(frac % 10)) {
+        frac /= 10;
+        --ndigit;
+      }
+      for (int32_t i=0; i<ndigit; ++i) {
+        tmp[len++] = '0' + frac % 10;
+        frac /= 10;
+      }
+      tmp[len++] = '.';
     }
-    return val;
+    do {
+      tmp[len++] = '0' + intpart % 10;
+      intpart /= 10;
+    } while (intpart);
+    if (val < 0) tmp[len++] = '-';
+
+    while (len) str += tmp[--len];
+  }
+
+  template <class T>
+  void writeBinary(std::ofstream &out, const T val)
+  {
+    out.write(reinterpret_cast<const char *>(&val), sizeof(T));
+  }
+}
+
+ProfileSample::ProfileSample(const vChrArray &vReadArray, const SamplePairEach &pair, const int32_t _stype):
+  ChIP(vReadArray.getArray(pair.argvChIP).array),
+  Input(nullptr),
+  stype(_stype)
+{
+  if (stype == 1) { // ChIP/Input enrichment
+    if (!pair.InputExists()) PRINTERR_AND_EXIT("Input sample is required for ChIP/Input enrichment: " << pair.label);
+    Input = &vReadArray.getArray(pair.argvInput).array;
   }
 }
 
-std::vector<genedata> ReadProfile::get_garray(const GeneDataMap &mp)
+void ProfileSample::getWindow(const int32_t sbin, const int32_t ebin, const bool reverse, double *out) const
 {
-  std::vector<genedata> garray;
-  for (auto &m: mp) {
-    if (m.second.gtype == "nonsense_mediated_decay"
-        || m.second.gtype == "processed_transcript"
-        || m.second.gtype == "retained_intron") continue;
-    garray.emplace_back(m.second);
+  int32_t n(ebin - sbin +1);
+  ChIP.copyRange(sbin, ebin, out);
+  if (stype == 1) {
+    bufInput.resize(n);
+    Input->copyRange(sbin, ebin, bufInput.data());
+    for (int32_t i=0; i<n; ++i) out[i] = bufInput[i] ? out[i] / bufInput[i] : 0;
   }
-  return garray;
+  if (reverse) std::reverse(out, out + n);
+}
+
+double ProfileSample::getAverage(const int32_t sbin, const int32_t ebin) const
+{
+  int32_t n(ebin - sbin +1);
+  if (n <= 0) return 0;
+  if (!stype) return getratio(ChIP.getRangeSum(sbin, ebin), n);
+
+  buf.resize(n);
+  getWindow(sbin, ebin, false, buf.data());
+  double sum(0);
+  for (int32_t i=0; i<n; ++i) sum += buf[i];
+  return getratio(sum, n);
 }
 
-void ReadProfile::WriteValAroundPosi(std::ofstream &out,
-                                     const SamplePairOverlayed &pair,
-                                     const vChrArray &vReadArray,
-                                     const int32_t posi, const std::string &strand)
+double ProfileSample::getMax(const int32_t sbin, const int32_t ebin) const
 {
-  int32_t bincenter(posi/binsize);
-  int32_t sbin(bincenter - binwidth_from_center);
-  int32_t ebin(bincenter + binwidth_from_center);
+  int32_t n(ebin - sbin +1);
+  if (n <= 0) return 0;
+  if (!stype) return std::max(0.0, ChIP.getRangeMax(sbin, ebin));
+
+  buf.resize(n);
+  getWindow(sbin, ebin, false, buf.data());
+  double max(0);
+  for (int32_t i=0; i<n; ++i) max = std::max(max, buf[i]);
+  return max;
+}
 
-  if (strand == "+") {
-    for (int32_t i=sbin; i<=ebin; ++i) out << "\t" << getReadVal(vReadArray, pair, i, stype);
+ProfileMatrix::ProfileMatrix(const std::string &prefix, const std::string &rowheader,
+                             const std::vector<std::string> &colname, const bool binary):
+  ncol(colname.size()), isbinary(binary)
+{
+  values.reserve(BLOCKSIZE * ncol);
+
+  std::string filename(prefix + (isbinary ? ".bin" : ".tsv"));
+  out.open(filename, std::ios::binary);
+  if (!out) PRINTERR_AND_EXIT("cannot open " << filename);
+
+  if (isbinary) {
+    std::string sitefile(prefix + ".sites.tsv");
+    outsite.open(sitefile);
+    if (!outsite) PRINTERR_AND_EXIT("cannot open " << sitefile);
+    outsite << (rowheader.empty() ? "name" : rowheader) << "\n";
+
+    // header: magic, version, ncol, tab-separated column names
+    std::string colstr;
+    for (auto &x: colname) colstr += (colstr.empty() ? "" : "\t") + x;
+    out.write("DDMATRIX", 8);
+    writeBinary<int32_t>(out, 1);
+    writeBinary<int32_t>(out, ncol);
+    writeBinary<int32_t>(out, colstr.size());
+    out.write(colstr.data(), colstr.size());
   } else {
-    for (int32_t i=ebin; i>=sbin; --i) out << "\t" << getReadVal(vReadArray, pair, i, stype);
+    out << rowheader;
+    for (auto &x: colname) out << "\t" << x;
+    out << "\n";
+  }
+}
+
+void ProfileMatrix::flushText()
+{
+  buf.clear();
+  for (size_t i=0; i<rowname.size(); ++i) {
+    buf += rowname[i];
+    for (int32_t j=0; j<ncol; ++j) {
+      buf += '\t';
+      appendValue(buf, values[i*ncol + j]);
+    }
+    buf += '\n';
   }
+  out.write(buf.data(), buf.size());
 }
 
-double ReadProfile::getAverageVal(const SamplePairOverlayed &pair,
-                                  const vChrArray &vReadArray,
-                                  const int32_t sbin,
-                                  const int32_t ebin)
+/* block: nrow (int32), compressed size (int32), deflated float32 values */
+void ProfileMatrix::flushBinary()
 {
-  double sumIP(0);
-  for (int32_t i=sbin; i<=ebin; ++i) sumIP += getReadVal(vReadArray, pair, i, stype);
-  return getratio(sumIP, (ebin - sbin + 1));
+  std::vector<float> fvalues(values.begin(), values.end());
+  uLong srclen(fvalues.size() * sizeof(float));
+  uLongf destlen(compressBound(srclen));
+  buf.resize(destlen);
+  if (compress2(reinterpret_cast<Bytef *>(&buf[0]), &destlen,
+                reinterpret_cast<const Bytef *>(fvalues.data()), srclen, Z_DEFAULT_COMPRESSION) != Z_OK) {
+    PRINTERR_AND_EXIT("failed to compress the profile matrix.");
+  }
+  writeBinary<int32_t>(out, rowname.size());
+  writeBinary<int32_t>(out, destlen);
+  out.write(buf.data(), destlen);
+
+  std::string str;
+  for (auto &x: rowname) str += x + "\n";
+  outsite.write(str.data(), str.size());
+}
+
+void ProfileMatrix::flush()
+{
+  if (rowname.empty()) return;
+
+  if (isbinary) flushBinary();
+  else          flushText();
+
+  rowname.clear();
+  values.clear();
 }
 
-double ReadProfile::getMaxVal(const SamplePairOverlayed &pair,
-                              const vChrArray &vReadArray,
-                              const int32_t sbin,
-                              const int32_t ebin)
+void ReadProfile::WriteSiteMatrix(const DROMPA::Global &p, const vChrArray &vReadArray,
+                                  const std::vector<ProfileSite> &sites)
 {
-  double maxIP(0);
-  for (int32_t i=sbin; i<=ebin; ++i) {
-    maxIP = std::max(maxIP, getReadVal(vReadArray, pair, i, stype));
+  for (size_t k=0; k<p.samplepair.size(); ++k) {
+    auto &x = p.samplepair[k];
+    ProfileSample sample(vReadArray, x.first, stype);
+    ProfileMatrix &matrix(*vmatrix[k]);
+
+    for (auto &site: sites) {
+      double *row(matrix.addRow(site.name));
+      sample.getWindow(site.bincenter - binwidth_from_center,
+                       site.bincenter + binwidth_from_center,
+                       site.reverse, row);
+      vstats[k].add(row);
+    }
   }
-  return maxIP;
 }
 
 ReadProfile::ReadProfile(const DROMPA::Global &p, const int32_t _nbin):
@@ -92,8 +261,8 @@ ReadProfile::ReadProfile(const DROMPA::Global &p, const int32_t _nbin):
   if (_nbin) nbin = _nbin;
   else nbin = binwidth_from_center * 2 +1;
 
-  std::vector<double> array(nbin, 0);
-  for (auto &x: p.samplepair) hprofile[x.first.argvChIP] = array;
+  for (int32_t i=-binwidth_from_center; i<=binwidth_from_center; ++i) xval.emplace_back(i*binsize);
+  vstats.assign(p.samplepair.size(), MyStatistics::RunningStats(nbin));
 }
 
 void ReadProfile::setOutputFilename(const DROMPA::Global &p, const std::string &commandname)
@@ -105,101 +274,159 @@ void ReadProfile::setOutputFilename(const DROMPA::Global &p, const std::string &
   if      (stype==0) prefix += ".ChIPread";
   else if (stype==1) prefix += ".Enrichment";
 
-  Rscriptname = prefix + ".R";
   RDataname   = prefix;
-  Rfigurename = prefix + ".pdf";
-  for (auto &x: {Rscriptname, RDataname, Rfigurename}) unlink(x.c_str());
+  summaryname = prefix + ".meanCI.tsv";
+  figurename  = prefix + ".pdf";
+  for (auto &x: {summaryname, figurename}) unlink(x.c_str());
+}
+
+void ReadProfile::WriteSummary(const DROMPA::Global &p)
+{
+  std::ofstream out(summaryname);
+  out << "position";
   for (auto &x: p.samplepair) {
-    std::string file(RDataname + "." + x.first.label + ".tsv");
-    //      std::cout << file << std::endl;
-    unlink(file.c_str());
+    out << "\t" << x.first.label << " mean"
+        << "\t" << x.first.label << " lower 95% CI"
+        << "\t" << x.first.label << " upper 95% CI";
+  }
+  out << std::endl;
+
+  for (int32_t i=0; i<nbin; ++i) {
+    out << xval[i];
+    for (auto &x: vstats) {
+      out << "\t" << x.getmean(i)
+          << "\t" << (x.getmean(i) - x.getCI95(i))
+          << "\t" << (x.getmean(i) + x.getCI95(i));
+    }
+    out << std::endl;
   }
-  for (auto &x: {Rscriptname, Rfigurename}) unlink(x.c_str());
 }
 
 void ReadProfile::MakeFigure(const DROMPA::Global &p)
 {
   std::cout << "\nMake figure.." << std::endl;
-  std::ofstream out(Rscriptname);
+  WriteSummary(p);
 
   std::vector<double> vcol({CLR_RED, CLR_BLUE, CLR_GREEN, CLR_LIGHTCORAL, CLR_BLACK, CLR_PURPLE, CLR_GRAY3, CLR_OLIVE, CLR_YELLOW3, CLR_SLATEGRAY, CLR_PINK, CLR_SALMON, CLR_GREEN2, CLR_BLUE3, CLR_PURPLE2, CLR_DARKORANGE});
-
-  for (size_t i=1; i<=p.samplepair.size(); ++i) {
-    out << "t <- read.table('"
-	<< RDataname << "." << p.samplepair[i-1].first.label << ".tsv"
-	<< "', header=F, sep='\\t', quote='')" << std::endl;
-    out << "t <- t[,-1]" << std::endl;
-    out << "n <- nrow(t)" << std::endl;
-
-
-    out << boost::format("t%1% <- t\n") % i;
-    out << boost::format("colnames(t%1%) <- t%1%[1,]\n") % i;
-    out << boost::format("t%1% <- t%1%[-1,]\n") % i;
-    out << boost::format("p%1% <- apply(t%1%,2,mean)\n") % i;
-    out << boost::format("sd%1% <- apply(t%1%,2,sd)\n") % i;
-    out << boost::format("SE%1% <- 1.96 * sd%1%/sqrt(n)\n") % i;
-    out << boost::format("p%1%_upper <- p%1% + SE%1%\n") % i;
-    out << boost::format("p%1%_lower <- p%1% - SE%1%\n") % i;
-    out << boost::format("x <- as.integer(colnames(t%1%))\n") % i;
+  size_t ncol(vcol.size()/3);
+
+  bool islog(p.prof.isPtypeGene100());
+  double ymin(0), ymax(0);
+  for (auto &x: vstats) {
+    for (int32_t i=0; i<nbin; ++i) {
+      double m(x.getmean(i));
+      ymax = std::max(ymax, m);
+      if (m > 0 && (!ymin || m < ymin)) ymin = m;
+    }
   }
-
-  out << "ymax <- ceiling(max(c(";
-  for (size_t i=1; i<=p.samplepair.size(); ++i) {
-    out << boost::format("max(p%1%)") % i;
-    if(i<p.samplepair.size()) out << ",";
-    else out << ")))\n";
+  ymax = ceil(ymax);
+  if (!ymax) ymax = 1;
+  if (!islog) ymin = 0;
+  else {
+    if (!ymin) ymin = 0.1;
+    if (ymin >= ymax) ymin = ymax / 10;
   }
-  out << "ymin <- ceiling(min(c(";
-  for (size_t i=1; i<=p.samplepair.size(); ++i) {
-    out << boost::format("min(p%1%)") % i;
-    if(i<p.samplepair.size()) out << ",";
-    else out << ")))\n";
+  double xmin(xval.front()), xmax(xval.back());
+  if (xmax <= xmin) {  // a single bin: widen the x-range by one bin to avoid dividing by zero
+    xmin -= binsize/2.0;
+    xmax += binsize/2.0;
   }
 
-  out << "pdf('" << Rfigurename << "',6,6)" << std::endl;
-  out << "plot(x,p1,type='l',col=rgb(" << vcol[0] << "," << vcol[1] << "," << vcol[2] << ")";
+  // 6 x 6 inch, as the previous R output
+  const int32_t width(432), height(432);
+  const double left(60), right(width - 15), top(20), bottom(height - 50);
 
-/*  double min(1);
-  for (size_t i=1; i<=p.samplepair.size(); ++i) {
-    for(j=0; j<num; j++){
-      if(min > sample[i].profile.IP[j]) min = sample[i].profile.IP[j];
+  auto getx = [&](const double x) { return left + (x - xmin) / (xmax - xmin) * (right - left); };
+  auto gety = [&](double y) {
+    if (islog) {
+      y = std::max(y, ymin);
+      return bottom - (log10(y) - log10(ymin)) / (log10(ymax) - log10(ymin)) * (bottom - top);
     }
+    return bottom - (y - ymin) / (ymax - ymin) * (bottom - top);
+  };
+
+  const auto surface = Cairo::PdfSurface::create(figurename, width, height);
+  const auto cr = Cairo::Context::create(surface);
+  cr->save();
+  cr->rectangle(left, top, right - left, bottom - top);
+  cr->clip();
+
+  // confidence intervals, then mean lines
+  for (size_t k=0; k<vstats.size(); ++k) {
+    size_t c(k % ncol);
+    cr->set_source_rgba(vcol[c*3], vcol[c*3+1], vcol[c*3+2], 0.3);
+    cr->move_to(getx(xval[0]), gety(vstats[k].getmean(0) + vstats[k].getCI95(0)));
+    for (int32_t i=1; i<nbin; ++i) cr->line_to(getx(xval[i]), gety(vstats[k].getmean(i) + vstats[k].getCI95(i)));
+    for (int32_t i=nbin-1; i>=0; --i) cr->line_to(getx(xval[i]), gety(vstats[k].getmean(i) - vstats[k].getCI95(i)));
+    cr->close_path();
+    cr->fill();
   }
-  min = (int)(min*10)/10.0;
-  if(!min) min = 0.1;*/
-
-  if (p.prof.isPtypeGene100()) out << ", log='y', ylim=c(ymin, ymax)";
-  else out << ", ylim=c(0, ymax)";
-
-  if (!stype) {
-    out << ",xlab='" << xlabel << "',ylab='Read density')" << std::endl;
-  } else if (stype==1) {
-    out << ",xlab='" << xlabel << "',ylab='ChIP/Input enrichment')" << std::endl;
+  cr->set_line_width(1);
+  for (size_t k=0; k<vstats.size(); ++k) {
+    size_t c(k % ncol);
+    cr->set_source_rgba(vcol[c*3], vcol[c*3+1], vcol[c*3+2], 1);
+    cr->move_to(getx(xval[0]), gety(vstats[k].getmean(0)));
+    for (int32_t i=1; i<nbin; ++i) cr->line_to(getx(xval[i]), gety(vstats[k].getmean(i)));
+    cr->stroke();
   }
-  out << "polygon(c(x, rev(x)), c(p1_lower, rev(p1_upper)), col=rgb("
-      << vcol[0] << "," << vcol[1] << "," << vcol[2] << ",0.3), border=NA)" << std::endl;
-
-  for (size_t i=1; i<p.samplepair.size(); ++i) {
-    std::string colstr = std::to_string(vcol[i*3]) + ","
-                       + std::to_string(vcol[i*3 +1]) + ","
-                       + std::to_string(vcol[i*3 +2]) + "";
-    out << boost::format("lines(x,p%1%,col=rgb(%2%))\n") % (i+1) % colstr;
-    out << boost::format("polygon(c(x, rev(x)), c(p%1%_lower, rev(p%1%_upper)), col=rgb(%2%,0.3), border=NA)\n") % (i+1) % colstr;
+  cr->restore();
+
+  // axes
+  cr->set_source_rgba(CLR_BLACK, 1);
+  cr->set_line_width(0.8);
+  cr->rectangle(left, top, right - left, bottom - top);
+  cr->stroke();
+
+  double xstep(getTickInterval(xmax - xmin));
+  for (double x = ceil(xmin / xstep) * xstep; x <= xmax; x += xstep) {
+    rel_yline(cr, getx(x), bottom, 5);
+    cr->stroke();
+    std::string str(getTickLabel(x));
+    showtext_cr(cr, getx(x) - 3*str.length(), bottom + 17, str, 10);
   }
-
-  out << "legend('bottomleft',c(";
-  for (size_t i=0; i<p.samplepair.size(); ++i) {
-    out << "'" << p.samplepair[i].first.label << "'";
-    if (i < p.samplepair.size()-1) out << ",";
+  std::vector<double> yticks;
+  if (islog) {
+    for (double y = pow(10, floor(log10(ymin))); y <= ymax; y *= 10) {
+      for (auto m: {1, 2, 5}) {
+        if (y*m >= ymin && y*m <= ymax) yticks.emplace_back(y*m);
+      }
+    }
+  } else {
+    double ystep(getTickInterval(ymax - ymin));
+    for (double y = ymin; y <= ymax + ystep*1e-6; y += ystep) yticks.emplace_back(y);
   }
-  out << "),col=c(rgb(" << vcol[0] << "," << vcol[1] << "," << vcol[2] <<")";
-  for (size_t i=1; i<p.samplepair.size(); ++i) {
-    out << ",rgb(" << vcol[i*3] << "," << vcol[i*3 +1] << "," << vcol[i*3 +2] << ")";
+  for (auto y: yticks) {
+    cr->move_to(left - 5, gety(y));
+    cr->line_to(left, gety(y));
+    cr->stroke();
+    std::string str(getTickLabel(y));
+    showtext_cr(cr, left - 8 - 6*str.length(), gety(y) + 4, str, 10);
   }
-  out << "), lwd=1.5)" << std::endl;
 
-  std::string command("R --vanilla < " + Rscriptname);
-  if(system(command.c_str())) PRINTERR_AND_EXIT("Rscript execution failed.");
+  showtext_cr(cr, (left + right)/2 - 3*xlabel.length(), height - 15, xlabel, 12);
+  std::string ylabel(stype ? "ChIP/Input enrichment" : "Read density");
+  cr->save();
+  cr->move_to(16, (top + bottom)/2 + 3*ylabel.length());
+  cr->rotate(-M_PI/2);
+  cr->set_font_size(12);
+  cr->show_text(ylabel);
+  cr->restore();
+
+  // legend
+  double ylegend(bottom - 10 - 14 * (p.samplepair.size() -1));
+  for (size_t k=0; k<p.samplepair.size(); ++k) {
+    size_t c(k % ncol);
+    cr->set_source_rgba(vcol[c*3], vcol[c*3+1], vcol[c*3+2], 1);
+    cr->set_line_width(1.5);
+    rel_xline(cr, left + 10, ylegend - 4, 20);
+    cr->stroke();
+    cr->set_source_rgba(CLR_BLACK, 1);
+    showtext_cr(cr, left + 35, ylegend, p.samplepair[k].first.label, 10);
+    ylegend += 14;
+  }
+
+  cr->show_page();
+  std::cout << "Wrote PDF file \"" << figurename << "\"" << std::endl;
 }
 
 
@@ -209,59 +436,51 @@ void ProfileTSS::WriteTSV_EachChr(const DROMPA::Global &p, const chrsize &chr)
 
   if(p.anno.genefile == "") PRINTERR_AND_EXIT("Please specify --gene.");
 
-  std::string chrname(rmchr(chr.getname()));
-  if (p.anno.gmp.find(chrname) == p.anno.gmp.end()) return;
-
-  vChrArray vReadArray(p, chr);
-
-  for (auto &x: p.samplepair) {
-    std::string file(RDataname + "." + x.first.label + ".tsv");
-    std::ofstream out(file, std::ios::app);
-
-    auto gmp(get_garray(p.anno.gmp.at(chrname)));
-
-    for (auto &gene: gmp) {
-      ++nsites;
-
-      int32_t position(0);
-      if (p.prof.isPtypeTSS()) {
-        if (gene.strand == "+") position = gene.txStart;
-        else                    position = gene.txEnd;
-      } else if (p.prof.isPtypeTTS()) {
-        if (gene.strand == "+") position = gene.txEnd;
-        else                    position = gene.txStart;
-      }
-      if (isExceedRange(position, chr.getlen())) {
-        ++nsites_skipped;
-        continue;
-      }
-      out << gene.tname;
-      WriteValAroundPosi(out, x, vReadArray, position, gene.strand);
-      out << std::endl;
+  const GeneIndex &gindex(p.anno.gindex.get(chr.getname()));
+  if (gindex.empty()) return;
+
+  std::vector<ProfileSite> sites;
+  for (auto pgene: gindex.getValues()) {
+    const genedata &gene(*pgene);
+    ++nsites;
+
+    int32_t position(0);
+    if (p.prof.isPtypeTSS()) {
+      if (gene.isPlus()) position = gene.txStart;
+      else                    position = gene.txEnd;
+    } else if (p.prof.isPtypeTTS()) {
+      if (gene.isPlus()) position = gene.txEnd;
+      else                    position = gene.txStart;
     }
-
-    out.close();
+    if (isExceedRange(position, chr.getlen())) {
+      ++nsites_skipped;
+      continue;
+    }
+    sites.emplace_back(gene.tname, position/binsize, !gene.isPlus());
   }
+  if (sites.empty()) return;
+
+  vChrArray vReadArray(p, chr, getSiteRegions(sites));
+  WriteSiteMatrix(p, vReadArray, sites);
 
   DEBUGprint_FUNCend();
 }
 
 
-void ProfileGene100::outputEachGene(std::ofstream &out, const SamplePairOverlayed &x,
-				    const genedata &gene, const vChrArray &vReadArray, int32_t len)
+void ProfileGene100::outputEachGene(double *row, const ProfileSample &sample, const genedata &gene, int32_t len)
 {
   int32_t s,e;
   double len100(len / (double)GENEBLOCKNUM);
 
   for (int32_t i=0; i<nbin; ++i) {
-    if (gene.strand == "+") {
+    if (gene.isPlus()) {
       s = (gene.txStart - len + len100 *i)       / binsize;
       e = (gene.txStart - len + len100 *(i+1) -1)/ binsize;
     }else{
       s = (gene.txEnd + len - len100 * (i+1))/ binsize;
       e = (gene.txEnd + len - len100 * i -1) / binsize;
     }
-    out << "\t" << getAverageVal(x, vReadArray, s, e);
+    row[i] = sample.getAverage(s, e);
   }
 }
 
@@ -271,29 +490,33 @@ void ProfileGene100::WriteTSV_EachChr(const DROMPA::Global &p, const chrsize &ch
 
   if(p.anno.genefile == "") PRINTERR_AND_EXIT("Please specify --gene.");
 
-  std::string chrname(rmchr(chr.getname()));
-  if (p.anno.gmp.find(chrname) == p.anno.gmp.end()) return;
-
-  vChrArray vReadArray(p, chr);
-  //    std::ofstream out(RDataname, std::ios::app);
-
-  for (auto &x: p.samplepair) {
-    std::string file(RDataname + "." + x.first.label + ".tsv");
-    std::ofstream out(file, std::ios::app);
-
-    auto gmp(get_garray(p.anno.gmp.at(chrname)));
-    for (auto &gene: gmp) {
-      ++nsites;
-
-      int32_t len(gene.length());
-      if (len < 1000 || gene.txEnd + len >= chr.getlen() || gene.txStart - len < 0) {
-        ++nsites_skipped;
-        continue;
-      }
-
-      out << gene.gname;
-      outputEachGene(out, x, gene, vReadArray, len);
-      out << std::endl;
+  const GeneIndex &gindex(p.anno.gindex.get(chr.getname()));
+  if (gindex.empty()) return;
+
+  std::vector<const genedata *> genes;
+  std::vector<range> regions;
+  for (auto pgene: gindex.getValues()) {
+    ++nsites;
+    int32_t len(pgene->length());
+    if (len < 1000 || pgene->txEnd + len >= chr.getlen() || pgene->txStart - len < 0) {
+      ++nsites_skipped;
+      continue;
+    }
+    genes.emplace_back(pgene);
+    regions.emplace_back(pgene->txStart - len, pgene->txEnd + len);
+  }
+  if (genes.empty()) return;
+
+  vChrArray vReadArray(p, chr, regions);
+
+  for (size_t k=0; k<p.samplepair.size(); ++k) {
+    auto &x = p.samplepair[k];
+    ProfileSample sample(vReadArray, x.first, stype);
+    ProfileMatrix &matrix(*vmatrix[k]);
+    for (auto pgene: genes) {
+      double *row(matrix.addRow(pgene->gname));
+      outputEachGene(row, sample, *pgene, pgene->length());
+      vstats[k].add(row);
     }
   }
 
@@ -306,28 +529,22 @@ void ProfileBedSites::WriteTSV_EachChr(const DROMPA::Global &p, const chrsize &c
 
   if(!p.anno.vbedlist.size()) PRINTERR_AND_EXIT("Please specify --bed.");
 
-  vChrArray vReadArray(p, chr);
-
-  for (auto &x: p.samplepair) {
-    std::string file(RDataname + "." + x.first.label + ".tsv");
-    std::ofstream out(file, std::ios::app);
-
-    for (auto &vbed: p.anno.vbedlist) {
-      for (auto &bed: vbed.getvBed()) {
-        if (bed.chr != chr.getname()) continue;
+  int32_t chrid(chrdict().getID(chr.getname()));
+  std::vector<ProfileSite> sites;
+  for (auto &vbed: p.anno.vbedlist) {
+    vbed.getBedChr(chrid).forEachInAddOrder([&] (const bed &bed) {
         ++nsites;
         if (isExceedRange(bed.summit, chr.getlen())) {
           ++nsites_skipped;
-          continue;
+          return;
         }
-        out << bed.getSiteStr();
-        WriteValAroundPosi(out, x, vReadArray, bed.summit, "+");
-        out << std::endl;
-      }
-    }
-
-    out.close();
+        sites.emplace_back(bed.getSiteStr(), bed.summit/binsize, false);
+      });
   }
+  if (sites.empty()) return;
+
+  vChrArray vReadArray(p, chr, getSiteRegions(sites));
+  WriteSiteMatrix(p, vReadArray, sites);
 
   DEBUGprint_FUNCend();
 }
@@ -338,35 +555,40 @@ void ProfileMULTICI::WriteTSV_EachChr(const DROMPA::Global &p, const chrsize &ch
 
   if(!p.anno.vbedlist.size()) PRINTERR_AND_EXIT("Please specify --bed.");
 
-  vChrArray vReadArray(p, chr);
+  int32_t chrid(chrdict().getID(chr.getname()));
+  std::vector<range> regions;
+  for (auto &vbed: p.anno.vbedlist) {
+    for (auto &bed: vbed.getBedChr(chrid).getValues()) regions.emplace_back(bed.start, bed.end);
+  }
+  if (regions.empty()) return;
 
-  std::string file(RDataname + ".tsv");
-  std::ofstream out(file, std::ios::app);
+  vChrArray vReadArray(p, chr, regions);
 
-  for (auto &vbed: p.anno.vbedlist) {
-    for (auto &bed: vbed.getvBed()) {
-      if (bed.chr != rmchr(chr.getname())) continue;
-      ++nsites;
+  std::vector<ProfileSample> samples;
+  for (auto &x: p.samplepair) samples.emplace_back(vReadArray, x.first, stype);
 
-      if (bed.start < 0 || bed.end >= chr.getlen()) {
-        ++nsites_skipped;
-        continue;
-      }
+  ProfileMatrix &matrix(*vmatrix[0]);
+
+  for (auto &vbed: p.anno.vbedlist) {
+    // rows in the order of the BED file as before the interval index
+    vbed.getBedChr(chrid).forEachInAddOrder([&] (const bed &bed) {
+        ++nsites;
 
-      int32_t sbin(bed.start/binsize);
-      int32_t ebin((bed.end-1)/binsize);
+        if (bed.start < 0 || bed.end >= chr.getlen()) {
+          ++nsites_skipped;
+          return;
+        }
 
-      if (p.isaddname()) out << bed.getSiteStrTABwithNAME();
-      else out << bed.getSiteStrTAB();
+        int32_t sbin(bed.start/binsize);
+        int32_t ebin((bed.end-1)/binsize);
 
-      for (auto &x: p.samplepair) {
-        if (p.isgetmaxval()) out << "\t" << getMaxVal(x, vReadArray, sbin, ebin);
-        else                 out << "\t" << getAverageVal(x, vReadArray, sbin, ebin);
-      }
-      out << std::endl;
-    }
+        double *row(matrix.addRow(p.isaddname() ? bed.getSiteStrTABwithNAME() : bed.getSiteStrTAB()));
+        for (size_t i=0; i<samples.size(); ++i) {
+          if (p.isgetmaxval()) row[i] = samples[i].getMax(sbin, ebin);
+          else                 row[i] = samples[i].getAverage(sbin, ebin);
+        }
+      });
   }
-  out.close();
 
   DEBUGprint_FUNCend();
 }
@@ -4,15 +4,77 @@
 #ifndef _DD_PROFILE_H_
 #define _DD_PROFILE_H_
 
+#include <memory>
 #include "dd_gv.hpp"
 #include "dd_readfile.hpp"
 
+/* Bin values of one sample pair on the current chromosome.
+ * The arrays are resolved once per chromosome instead of for each bin. */
+class ProfileSample {
+  const WigArray &ChIP;
+  const WigArray *Input;
+  int32_t stype;
+  mutable std::vector<double> buf;
+  mutable std::vector<double> bufInput;
+
+public:
+  ProfileSample(const vChrArray &vReadArray, const SamplePairEach &pair, const int32_t _stype);
+
+  void getWindow(const int32_t sbin, const int32_t ebin, const bool reverse, double *out) const;
+  double getAverage(const int32_t sbin, const int32_t ebin) const;
+  double getMax(const int32_t sbin, const int32_t ebin) const;
+};
+
+/* Rows of a profile matrix, written to the file in blocks.
+ * The file is kept open for the whole run.
+ * TSV: <prefix>.tsv
+ * binary: <prefix>.bin (float32, row-major, deflate-compressed blocks)
+ *         and <prefix>.sites.tsv (row names) */
+class ProfileMatrix {
+  enum {BLOCKSIZE=4096};
+  int32_t ncol;
+  bool isbinary;
+  std::ofstream out;
+  std::ofstream outsite;
+  std::vector<std::string> rowname;
+  std::vector<double> values;
+  std::string buf;
+
+  void flushText();
+  void flushBinary();
+
+public:
+  ProfileMatrix(const std::string &prefix, const std::string &rowheader,
+                const std::vector<std::string> &colname, const bool binary);
+  ~ProfileMatrix() { flush(); }
+
+  // the returned row is valid until the next addRow()
+  double * addRow(const std::string &name) {
+    if (rowname.size() == BLOCKSIZE) flush();
+    rowname.emplace_back(name);
+    values.resize(rowname.size() * ncol);
+    return &values[(rowname.size()-1) * ncol];
+  }
+  void flush();
+};
+
 class ReadProfile {
   std::string xlabel;
-  std::string Rscriptname;
-  std::string Rfigurename;
+  std::string summaryname;
+  std::string figurename;
+
+  void WriteSummary(const DROMPA::Global &p);
 
 protected:
+  class ProfileSite {
+  public:
+    std::string name;
+    int32_t bincenter;
+    bool reverse;
+    ProfileSite(const std::string &n, const int32_t b, const bool r):
+      name(n), bincenter(b), reverse(r) {}
+  };
+
   int32_t stype;
   int32_t binsize;
   int32_t nbin;
@@ -23,26 +85,26 @@ protected:
   int32_t nsites_skipped;
 
   std::string RDataname;
-  std::unordered_map<std::string, std::vector<double>> hprofile;
-
-  std::vector<genedata> get_garray(const GeneDataMap &mp);
+  std::vector<int32_t> xval;  // column labels of the matrix
+  std::vector<MyStatistics::RunningStats> vstats;  // for each sample pair
+  std::vector<std::unique_ptr<ProfileMatrix>> vmatrix;
 
   int32_t isExceedRange(const int32_t posi, const int32_t chrlen) {
     return posi - width_from_center < 0 || posi + width_from_center >= chrlen;
   }
 
-  void WriteValAroundPosi(std::ofstream &out,
-                          const SamplePairOverlayed &pair,
-                          const vChrArray &vReadArray,
-                          const int32_t posi,
-                          const std::string &strand);
+  // windows of the sites in bp, so that only the bins around them are read
+  std::vector<range> getSiteRegions(const std::vector<ProfileSite> &sites) const {
+    std::vector<range> regions;
+    for (auto &x: sites) {
+      regions.emplace_back((x.bincenter - binwidth_from_center) * binsize,
+                           (x.bincenter + binwidth_from_center +1) * binsize);
+    }
+    return regions;
+  }
 
-  double getAverageVal(const SamplePairOverlayed &pair,
-                       const vChrArray &vReadArray,
-                       const int32_t sbin, const int32_t ebin);
-  double getMaxVal(const SamplePairOverlayed &pair,
-                   const vChrArray &vReadArray,
-                   const int32_t sbin, const int32_t ebin);
+  void WriteSiteMatrix(const DROMPA::Global &p, const vChrArray &vReadArray,
+                       const std::vector<ProfileSite> &sites);
 
 public:
   ReadProfile(const DROMPA::Global &p, const int32_t _nbin=0);
@@ -51,16 +113,14 @@ public:
   virtual void WriteTSV_EachChr(const DROMPA::Global &p, const chrsize &chr)=0;
 
   virtual void printHead(const DROMPA::Global &p) {
+    std::vector<std::string> colname;
+    for (auto &v: xval) colname.emplace_back(std::to_string(v));
     for (auto &x: p.samplepair) {
-      std::string file(RDataname + "." + x.first.label + ".tsv");
-      std::ofstream out(file);
-      for (int32_t i=-binwidth_from_center; i<=binwidth_from_center; ++i) {
-        out << "\t" << (i*binsize);
-      }
-      out << std::endl;
-      out.close();
+      vmatrix.emplace_back(std::make_unique<ProfileMatrix>(RDataname + "." + x.first.label, "",
+                                                           colname, p.prof.isBinaryMatrix()));
     }
   }
+  void closeMatrix() { vmatrix.clear(); }
 
   void printNumOfSites() const {
     std::cout << "\n\nthe number of sites: " << nsites << std::endl;
@@ -82,26 +142,17 @@ public:
 class ProfileGene100: public ReadProfile {
   enum {GENEBLOCKNUM=100};
 
-  void outputEachGene(std::ofstream &out, const SamplePairOverlayed &x,
-                      const genedata &gene, const vChrArray &vReadArray, int32_t len);
+  void outputEachGene(double *row, const ProfileSample &sample, const genedata &gene, int32_t len);
 
 public:
   explicit ProfileGene100(const DROMPA::Global &p):
-    ReadProfile(p, GENEBLOCKNUM * 3) {}
+    ReadProfile(p, GENEBLOCKNUM * 3)
+  {
+    xval.clear();
+    for (int32_t i=-GENEBLOCKNUM; i<GENEBLOCKNUM*2; ++i) xval.emplace_back(i);
+  }
 
   void WriteTSV_EachChr(const DROMPA::Global &p, const chrsize &chr);
-
-  void printHead(const DROMPA::Global &p) {
-    for (auto &x: p.samplepair) {
-      std::string file(RDataname + "." + x.first.label + ".tsv");
-      std::ofstream out(file);
-      for (int32_t i=-GENEBLOCKNUM; i<GENEBLOCKNUM*2; ++i) {
-        out << "\t" << i;
-      }
-      out << std::endl;
-      out.close();
-    }
-  }
 };
 
 class ProfileBedSites: public ReadProfile {
@@ -120,14 +171,12 @@ public:
   void WriteTSV_EachChr(const DROMPA::Global &p, const chrsize &chr);
 
   void printHead(const DROMPA::Global &p) {
-    std::string file(RDataname + ".tsv");
-    std::ofstream out(file);
-    out << "chromosome\tstart\tend";
-    if (p.isaddname())  out << "\tname";
-
-    for (auto &x: p.samplepair) out << "\t" << x.first.label;
-    out << std::endl;
-    out.close();
+    std::string rowheader("chromosome\tstart\tend");
+    if (p.isaddname()) rowheader += "\tname";
+
+    std::vector<std::string> colname;
+    for (auto &x: p.samplepair) colname.emplace_back(x.first.label);
+    vmatrix.emplace_back(std::make_unique<ProfileMatrix>(RDataname, rowheader, colname, p.prof.isBinaryMatrix()));
   }
 };
 
@@ -145,6 +194,7 @@ void exec_PROFILE_asType(DROMPA::Global &p)
 
     profile.WriteTSV_EachChr(p, chr);
   }
+  profile.closeMatrix();
 
   profile.printNumOfSites();
   profile.MakeFigure(p);
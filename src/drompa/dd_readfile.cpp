@@ -1,8 +1,14 @@
 /* Copyright(c)  Ryuichiro Nakato <rnakato@iam.u-tokyo.ac.jp>
  * All rights reserved.
  */
+#include <algorithm>
+#include <stdexcept>
 #include "../submodules/SSP/common/gzstream.h"
 #include "dd_readfile.hpp"
+#include "dd_bigwig.hpp"
+#include "dd_draw_myfunc.hpp"
+#include "significancetest.hpp"
+#include "RunParallel.hpp"
 
 namespace {
   void SplitBedGraphLine(std::vector<std::string> &v, const std::string &str)
@@ -43,7 +49,7 @@ namespace {
                     const std::string &chrname, const int32_t binsize)
   {
     std::ifstream in(filename);
-    if (!in) PRINTERR_AND_EXIT("cannot open " << filename);
+    if (!in) throw std::runtime_error("cannot open " + filename);
 
     DEBUGprint_FUNCStart();
 
@@ -63,7 +69,7 @@ namespace {
 
       int32_t start(stoi(v[1]));
       int32_t end(stoi(v[2])-1);
-      if (start%binsize) PRINTERR_AND_EXIT("ERROR: invalid start position: " << start << " for binsize " << binsize);
+      if (start%binsize) throw std::runtime_error("invalid start position: " + std::to_string(start) + " for binsize " + std::to_string(binsize) + " in " + filename);
       int32_t s(start/binsize);
       int32_t e(end/binsize);
       //    std::cout << s << "\t " << e << "\t " << array.size() << "\t" << stod(v[3]) << std::endl;
@@ -82,7 +88,7 @@ namespace {
     DEBUGprint_FUNCStart();
 
     std::ifstream in(filename);
-    if (!in) PRINTERR_AND_EXIT("cannot open " << filename);
+    if (!in) throw std::runtime_error("cannot open " + filename);
     readWig(in, array, chrname, binsize);
     in.close();
 
@@ -100,27 +106,22 @@ namespace {
     DEBUGprint_FUNCend();
   }
 
+  /* the index is read in-process, so only the data blocks overlapping the regions are read and decompressed */
   void funcBigWig(WigArray &array, const std::string &filename,
-                  const int32_t binsize, const std::string &chrname)
+                  const int32_t binsize, const std::string &chrname,
+                  const std::vector<range> &regions)
   {
     DEBUGprint_FUNCStart();
 
-    int32_t fd(0);
-    char tmpfile[] = "/tmp/DROMPAplus_bigWigToBedGraph_XXXXXXXX";
-    if ((fd = mkstemp(tmpfile)) < 0) {
-      perror("mkstemp");
-      //      fd = EXIT_FAILURE;
-    }
-    std::string command = "bigWigToBedGraph -chrom=chr" + rmchr(chrname) + " " + filename + " " + std::string(tmpfile);
-    int32_t return_code = system(command.c_str());
-    if (WEXITSTATUS(return_code)) {
-      PRINTERR_AND_EXIT("Error: command " << command
-                        << "return nonzero status. "
-                        << "Add the PATH to 'DROMPAplus/otherbins'.");
-    }
-    readBedGraph(array, std::string(tmpfile), chrname, binsize);
-    unlink(tmpfile);
-    close(fd);
+    std::vector<std::pair<int32_t, int32_t>> vregion;
+    for (auto &x: regions) vregion.emplace_back(x.start, x.end);
+
+    readBigWig(filename, "chr" + rmchr(chrname), vregion, [&] (const int32_t start, const int32_t end, const float val) {
+        if (start%binsize) throw std::runtime_error("invalid start position: " + std::to_string(start) + " for binsize " + std::to_string(binsize) + " in " + filename);
+        int32_t s(start/binsize);
+        int32_t e((end-1)/binsize);
+        for(int32_t i=s; i<=e; ++i) array.setval(i, val);
+      });
 
     DEBUGprint_FUNCend();
   }
@@ -134,9 +135,35 @@ namespace {
 
     DEBUGprint_FUNCend();
   }
+
+  /* drawregions extended by the margin for smoothing and local averages, aligned to bins and merged
+     in one sweep over the sorted regions when they overlap or touch.
+     Empty (the whole chromosome) when drawregions is empty. */
+  std::vector<range> getLoadRegions(const DROMPA::Global &p, const std::vector<range> &drawregions,
+                                    const int32_t binsize, const int32_t chrlen)
+  {
+    std::vector<range> regions;
+    if (drawregions.empty()) return regions;
+
+    int32_t margin((p.getSmoothing() +1) * binsize);
+    if (p.drawparam.showpinter) margin += WigArray::getLocalAverageLength()/2;
+
+    std::vector<range> sorted(drawregions);
+    std::sort(sorted.begin(), sorted.end(), [] (const range &a, const range &b) { return a.start < b.start; });
+
+    for (auto &x: sorted) {
+      int32_t s(std::max(0, x.start - margin) / binsize * binsize);
+      int32_t e(std::min(chrlen, (std::min(chrlen, x.end + margin) / binsize +1) * binsize));
+      if (!regions.empty() && s <= regions.back().end) regions.back().end = std::max(regions.back().end, e);
+      else regions.emplace_back(s, e);
+    }
+
+    return regions;
+  }
 }
 
-WigArray loadWigData(const std::string &filename, const SampleInfo &x, const chrsize &chr)
+WigArray loadWigData(const std::string &filename, const SampleInfo &x, const chrsize &chr,
+                     const std::vector<range> &regions)
 {
   int32_t binsize(x.getbinsize());
   int32_t nbin(chr.getlen()/binsize +1);
@@ -145,10 +172,10 @@ WigArray loadWigData(const std::string &filename, const SampleInfo &x, const chr
   std::string chrname(chr.getrefname());
   WigType iftype(x.getiftype());
 
-  if (iftype == WigType::NONE) PRINTERR_AND_EXIT("Suffix error of "<< filename <<". please specify --iftype option.");
+  if (iftype == WigType::NONE) throw std::runtime_error("Suffix error of " + filename + ". please specify --iftype option.");
   else if (iftype == WigType::UNCOMPRESSWIG) funcWig(array, filename, binsize, chrname);
   else if (iftype == WigType::COMPRESSWIG)   funcCompressWig(array, filename, binsize, chrname);
-  else if (iftype == WigType::BIGWIG)        funcBigWig(array, filename, binsize, chrname);
+  else if (iftype == WigType::BIGWIG)        funcBigWig(array, filename, binsize, chrname, regions);
   else if (iftype == WigType::BEDGRAPH)      funcBedGraph(array, filename, binsize, chrname);
 
   //array.dump();
@@ -157,18 +184,27 @@ WigArray loadWigData(const std::string &filename, const SampleInfo &x, const chr
 }
 
 
-vChrArray::vChrArray(const DROMPA::Global &p, const chrsize &_chr):
-  chr(_chr)
+vChrArray::vChrArray(const DROMPA::Global &p, const chrsize &_chr,
+                     const std::vector<range> &drawregions):
+  chr(_chr), chrid(chrdict().getID(chr.getname()))
 {
   std::cout << "Load sample data..";
+  // samples are read in parallel; the entries are made in advance so that the map is not modified by the threads
+  std::vector<std::pair<const std::string, SampleInfo> const *> vsample;
   for (auto &x: p.vsinfo.getarray()) {
-    clock_t t1,t2;
-    t1 = clock();
-    arrays[x.first] = ChrArray(p, x, chr);
-    t2 = clock();
-    PrintTime(t1, t2, "ChrArray new");
+    arrays[x.first];
+    vsample.emplace_back(&x);
   }
 
+  runParallel(p.getNumThreads(), vsample.size(), [&] (const size_t i) {
+      auto &x = *vsample[i];
+      clock_t t1,t2;
+      t1 = clock();
+      arrays.at(x.first) = ChrArray(p, x, chr, getLoadRegions(p, drawregions, x.second.getbinsize(), chr.getlen()));
+      t2 = clock();
+      PrintTime(t1, t2, "ChrArray new");
+    });
+
 #ifdef DEBUG
   std::cout << "all WigArray:" << std::endl;
   for (auto &x: arrays) {
@@ -181,3 +217,73 @@ vChrArray::vChrArray(const DROMPA::Global &p, const chrsize &_chr):
   }
 #endif
 }
+
+const SignalTrack & vChrArray::getSignalTrack(const SamplePairEach &pair) const
+{
+  std::string key(pair.argvChIP + "\t" + pair.argvInput);
+  auto itr = tracks.find(key);
+  if (itr == tracks.end()) {
+    const ChrArray *input(pair.InputExists() ? &getArray(pair.argvInput) : nullptr);
+    itr = tracks.emplace(key, SignalTrack(getArray(pair.argvChIP), input, pair.ratio)).first;
+  }
+  return itr->second;
+}
+
+void vChrArray::prepareSignalTracks(const DROMPA::Global &p) const
+{
+  auto prepare = [&] (const SamplePairEach &pair) {
+    const SignalTrack &track(getSignalTrack(pair));
+    if (p.drawparam.showpinter) track.getPinter();
+    if (!pair.InputExists()) return;
+    if (p.drawparam.showpenrich) track.getPenrich();
+    if (p.drawparam.showratio)   track.getRatio();
+  };
+  for (auto &x: p.samplepair) {
+    prepare(x.first);
+    if (x.OverlayExists()) prepare(x.second);
+  }
+}
+
+const std::vector<double> & SignalTrack::getRatio() const
+{
+  if (ratio.empty()) {
+    const WigArray &c(chip.array);
+    const WigArray &i(getInputArray());
+    ratio.resize(c.size());
+    for (size_t j=0; j<c.size(); ++j) ratio[j] = CalcRatio(c[j], i[j], scaling);
+  }
+  return ratio;
+}
+
+const std::vector<double> & SignalTrack::getRawRatio() const
+{
+  if (rawratio.empty()) {
+    const WigArray &c(chip.array);
+    const WigArray &i(getInputArray());
+    rawratio.resize(c.size());
+    for (size_t j=0; j<c.size(); ++j) rawratio[j] = getratio(c[j], i[j]);
+  }
+  return rawratio;
+}
+
+const std::vector<double> & SignalTrack::getPinter() const
+{
+  if (pinter.empty()) {
+    const WigArray &c(chip.array);
+    std::vector<double> ave(c.getLocalAverages(chip.binsize));
+    pinter.resize(c.size());
+    for (size_t j=0; j<c.size(); ++j) pinter[j] = getlogp_Poisson(c[j], ave[j]);
+  }
+  return pinter;
+}
+
+const std::vector<double> & SignalTrack::getPenrich() const
+{
+  if (penrich.empty()) {
+    const WigArray &c(chip.array);
+    const WigArray &i(getInputArray());
+    penrich.resize(c.size());
+    for (size_t j=0; j<c.size(); ++j) penrich[j] = getlogp_BinomialTest(c[j], i[j], scaling);
+  }
+  return penrich;
+}
@@ -10,26 +10,49 @@
 #include "dd_gv.hpp"
 #include "../submodules/SSP/common/seq.hpp"
 
-WigArray loadWigData(const std::string &filename, const SampleInfo &x, const chrsize &chr);
+/* regions: [start, end) in bp to be read, sorted and disjoint (the whole chromosome if empty).
+   Only bigWig files are read partially via their index; the other formats are read entirely. */
+WigArray loadWigData(const std::string &filename, const SampleInfo &x, const chrsize &chr,
+                     const std::vector<range> &regions=std::vector<range>());
 
 class ChrArray {
+  enum {MAXZOOMLEVEL=16};
+
+  class ZoomArray {
+  public:
+    WigArray mean;
+    WigArray max;
+    ZoomArray(const WigArray &m, const WigArray &x): mean(m), max(x) {}
+  };
+  mutable std::vector<ZoomArray> zoom;  // zoom[k]: 2^(k+1) bins merged
+
+  const ZoomArray & getZoom(const int32_t level) const {
+    if (level < 1 || level > MAXZOOMLEVEL) PRINTERR_AND_EXIT("Invalid zoom level: " << level);
+    while (static_cast<int32_t>(zoom.size()) < level) {
+      if (zoom.empty()) zoom.emplace_back(array.getDownsampled(false), array.getDownsampled(true));
+      else zoom.emplace_back(zoom.back().mean.getDownsampled(false), zoom.back().max.getDownsampled(true));
+    }
+    return zoom[level-1];
+  }
+
 public:
   int32_t binsize;
   int32_t nbin;
   WigArray array;
   WigStats stats;
   int32_t totalreadnum;
-  std::unordered_map<std::string, int32_t> totalreadnum_chr;
+  int32_t totalreadnum_chr;  // of this chromosome
 
   ChrArray(){}
   ChrArray(const DROMPA::Global &p,
 	   const std::pair<const std::string, SampleInfo> &x,
-	   const chrsize &chr):
+	   const chrsize &chr,
+	   const std::vector<range> &regions):
     binsize(x.second.getbinsize()), nbin(chr.getlen()/binsize +1),
-    array(loadWigData(x.first, x.second, chr)),
+    array(loadWigData(x.first, x.second, chr, regions)),
     stats(nbin, binsize),
     totalreadnum(x.second.gettotalreadnum()),
-    totalreadnum_chr(x.second.gettotalreadnum_chr())
+    totalreadnum_chr(x.second.gettotalreadnum_chr().get(chr.getname()))
   {
     clock_t t1,t2;
     t1 = clock();
@@ -41,19 +64,87 @@ public:
     t2 = clock();
     PrintTime(t1, t2, "WigStats");
   }
+
+  /* bins merged by 2^level (level >= 1), built on first use like bigWig zoom levels.
+     Not thread-safe: call prepareZoom() before drawing pages in parallel. */
+  const WigArray & getZoomMean(const int32_t level) const { return getZoom(level).mean; }
+  const WigArray & getZoomMax(const int32_t level) const { return getZoom(level).max; }
+
+  // the coarsest level whose bins are not wider than one pixel
+  static int32_t getZoomLevel(const double dot_per_bin) {
+    int32_t level(0);
+    while (level < MAXZOOMLEVEL && dot_per_bin * (2 << level) <= 1) ++level;
+    return level;
+  }
+  // build the zoom level used for pages with dot_per_bp in advance
+  void prepareZoom(const double dot_per_bp) const {
+    int32_t level(getZoomLevel(binsize * dot_per_bp));
+    if (level) getZoom(level);
+  }
+};
+
+/* Values of a ChIP/Input pair for each bin, shared by peak calling, GENWIG and drawing:
+     ratio:   ChIP/Input with the scaling factor
+     rawratio: ChIP/Input without the scaling factor (GENWIG)
+     pinter:  -log10(p) of ChIP against the local background (Poisson)
+     penrich: -log10(p) of ChIP against Input (binomial)
+   Each column is computed on first use. */
+class SignalTrack {
+  const ChrArray &chip;
+  const ChrArray *input;  // nullptr without Input
+  double scaling;
+  mutable std::vector<double> ratio;
+  mutable std::vector<double> rawratio;
+  mutable std::vector<double> pinter;
+  mutable std::vector<double> penrich;
+
+  const WigArray & getInputArray() const {
+    if (!input) PRINTERR_AND_EXIT("SignalTrack: no Input sample.");
+    return input->array;
+  }
+
+public:
+  SignalTrack(const ChrArray &c, const ChrArray *i, const double r):
+    chip(c), input(i), scaling(r)
+  {}
+
+  const std::vector<double> & getRatio() const;
+  const std::vector<double> & getRawRatio() const;
+  const std::vector<double> & getPinter() const;
+  const std::vector<double> & getPenrich() const;
+  // 0: rawratio, 1: pinter, 2: penrich (as GENWIG --outputvalue)
+  const std::vector<double> & getValues(const int32_t type) const {
+    if (type == 0) return getRawRatio();
+    if (type == 1) return getPinter();
+    return getPenrich();
+  }
 };
 
 class vChrArray {
   const chrsize &chr;
+  int32_t chrid;
   std::unordered_map<std::string, ChrArray> arrays;
+  mutable std::unordered_map<std::string, SignalTrack> tracks;  // key: ChIP and Input
 
 public:
-  vChrArray(const DROMPA::Global &p, const chrsize &_chr);
+  /* drawregions: [start, end) in bp to be drawn (the whole chromosome if empty).
+     The bins around them needed for smoothing and local averages are also read. */
+  vChrArray(const DROMPA::Global &p, const chrsize &_chr,
+            const std::vector<range> &drawregions=std::vector<range>());
 
   const ChrArray & getArray(const std::string &str) const {
     return arrays.at(str);
   }
+  /* the scaling factor of the pair (set for this chromosome) is used when the track is made.
+     Not thread-safe: call prepareSignalTracks() before drawing pages in parallel. */
+  const SignalTrack & getSignalTrack(const SamplePairEach &pair) const;
+  // compute the columns drawn with the current options
+  void prepareSignalTracks(const DROMPA::Global &p) const;
   const chrsize & getchr() const { return chr; }
+  int32_t getchrid() const { return chrid; }
+  void prepareZoom(const double dot_per_bp) const {
+    for (auto &x: arrays) x.second.prepareZoom(dot_per_bp);
+  }
   int32_t getchrlen() const { return chr.getlen(); }
 };
 
@@ -26,7 +26,7 @@ namespace {
   void OutputStatsfileForOtherData(const std::string &filename,
                                    const std::string &statsfile,
                                    const std::vector<chrsize> &gt,
-                                   const std::unordered_map<std::string, int32_t> &totalreadnum_chr,
+                                   const ChrVector<int32_t> &totalreadnum_chr,
                                    int32_t totalreadnum)
   {
     std::cout << statsfile << " not found. Generating...";
@@ -48,8 +48,8 @@ namespace {
         << std::endl;
     for (auto &chr: gt) {
       out << chr.getrefname() << "\t"
-          << totalreadnum_chr.at(chr.getname()) << "\t"
-          << getratio(totalreadnum_chr.at(chr.getname()) * flen, chr.getlen())
+          << totalreadnum_chr.get(chr.getname()) << "\t"
+          << getratio(totalreadnum_chr.get(chr.getname()) * flen, chr.getlen())
           << std::endl;
     }
 
@@ -127,7 +127,7 @@ void SampleInfo::scanStatsFile(const std::string &filename)
       break;
     case PARSE2WIG:
       ParseLine(v, lineStr, '\t');
-      totalreadnum_chr[v[0]] = stoi(v[ncol_readnum]);
+      totalreadnum_chr[chrdict().intern(v[0])] = stoi(v[ncol_readnum]);
       break;
     case OTHER:
       if (isStr(lineStr, "Genome")) {
@@ -138,7 +138,7 @@ void SampleInfo::scanStatsFile(const std::string &filename)
       break;
     case OTHER_CHR:
       ParseLine(v, lineStr, '\t');
-      totalreadnum_chr[rmchr(v[0])] = stoi(v[1]);
+      totalreadnum_chr[chrdict().intern(v[0])] = stoi(v[1]);
       break;
     }
   }
@@ -154,8 +154,9 @@ void SampleInfo::gettotalreadnum(const std::string &filename, const std::vector<
     DEBUGprint("loadWigData: noStatsFile...");
     for (auto &chr: gt) {
       WigArray array(loadWigData(filename, *this, chr));
-      totalreadnum_chr[chr.getname()] = array.getArraySum();
-      totalreadnum += totalreadnum_chr[chr.getname()];
+      int32_t id(chrdict().intern(chr.getname()));
+      totalreadnum_chr[id] = array.getArraySum();
+      totalreadnum += totalreadnum_chr[id];
     }
     OutputStatsfileForOtherData(filename, statsfile, gt, totalreadnum_chr, totalreadnum);
   }
@@ -164,7 +165,7 @@ void SampleInfo::gettotalreadnum(const std::string &filename, const std::vector<
     std::cout << "Total read number:" << std::endl;
     std::cout << "Whole genome: " << totalreadnum << std::endl;
     for (auto &chr: gt) {
-      std::cout << chr.getname() << ": " << totalreadnum_chr[chr.getname()] << std::endl;
+      std::cout << chr.getname() << ": " << totalreadnum_chr.get(chr.getname()) << std::endl;
     }
 #endif
 }
@@ -217,7 +218,7 @@ SamplePairEach::SamplePairEach(const std::string &str, const vSampleInfo &vsinfo
   if (v.size() >=2 && v[1] != "") argvInput = v[1];
   if (v.size() >=3 && v[2] != "") label     = v[2]; else label = v[0];
   if (v.size() >=4 && v[3] != "") peak_argv = v[3];
-  if (peak_argv != "") vbedregions = parseBed_Hash<bed>(peak_argv);
+  if (peak_argv != "") vbedregions = construct_BedIndex(parseBed<bed>(peak_argv));
   binsize = vsinfo.getbinsize(argvChIP);
   if (v.size() >=6 && v[5] != "") scale.tag = stod(v[5]);
   if (v.size() >=7 && v[6] != "") scale.ratio = stod(v[6]);
@@ -243,8 +244,8 @@ void SamplePairEach::setScalingFactor(const int32_t normtype,
                      vReadArray.getArray(argvInput).totalreadnum);
     break;
   case 2:  // total read for each chromosome
-    ratio = getratio(vReadArray.getArray(argvChIP).totalreadnum_chr.at(chrname),
-                     vReadArray.getArray(argvInput).totalreadnum_chr.at(chrname));
+    ratio = getratio(vReadArray.getArray(argvChIP).totalreadnum_chr,
+                     vReadArray.getArray(argvInput).totalreadnum_chr);
     break;
   case 3:  // NCIS
     ratio = 1;
@@ -256,49 +257,24 @@ void SamplePairEach::setScalingFactor(const int32_t normtype,
   DEBUGprint_FUNCend();
 }
 
-void SamplePairEach::genEnrichWig(const vChrArray &vReadArray, const std::string &chrname, const int32_t chrlen)
-{
-  DEBUGprint_FUNCStart();
-
-  const WigArray &ChIParray  = vReadArray.getArray(argvChIP).array;
-  const WigArray &Inputarray = vReadArray.getArray(argvInput).array;
-
-  WigArray wigarray(ChIParray.size(), 0);
-
-  for (size_t i=0; i<ChIParray.size(); ++i) {
-    if      (ofvaluetype == 0) wigarray.setval(i, getratio(ChIParray[i], (double)Inputarray[i]));
-    else if (ofvaluetype == 1) wigarray.setval(i, getlogp_Poisson(ChIParray[i], ChIParray.getLocalAverage(i, binsize)));
-    else if (ofvaluetype == 2) wigarray.setval(i, getlogp_BinomialTest(ChIParray[i], Inputarray[i], ratio));
-    else {
-      PRINTERR_AND_EXIT("Invalid outputvaluetype: " << ofvaluetype);
-    }
-  }
-
-  bool showzero(true);
-  bool isfloat(true);
-  if (oftype==WigType::COMPRESSWIG || oftype==WigType::UNCOMPRESSWIG) {
-    fprintf(File, "variableStep\tchrom=%s\tspan=%d\n", chrname.c_str(), binsize);
-    wigarray.outputAsWig(File, binsize, showzero, isfloat);
-  } else if (oftype==WigType::BEDGRAPH || oftype==WigType::BIGWIG) {
-    wigarray.outputAsBedGraph(File, binsize, chrname, chrlen-1, showzero, isfloat);
-  }
-
-  DEBUGprint_FUNCend();
-}
-
 void SamplePairEach::peakcall_withInput(const vChrArray &vReadArray, const std::string &chrname,
                                         const double pthre_inter, const double pthre_enrich,
                                         const double ethre, const double ipm)
 {
   int32_t ext(0);
+  std::vector<Peak> peaks;
 
   const WigArray &ChIParray  = vReadArray.getArray(argvChIP).array;
   const WigArray &Inputarray = vReadArray.getArray(argvInput).array;
+  const SignalTrack &track(vReadArray.getSignalTrack(*this));
+  const std::vector<double> &pinter(track.getPinter());
+  const std::vector<double> &penrich(track.getPenrich());
+  const std::vector<double> &enrich(track.getRatio());
 
   for (size_t i=0; i<ChIParray.size(); ++i) {
-    double logp_inter(getlogp_Poisson(ChIParray[i], ChIParray.getLocalAverage(i, binsize)));
-    double logp_enrich(getlogp_BinomialTest(ChIParray[i], Inputarray[i], ratio));
-    double ratio_i(CalcRatio(ChIParray[i], Inputarray[i], ratio));
+    double logp_inter(pinter[i]);
+    double logp_enrich(penrich[i]);
+    double ratio_i(enrich[i]);
 
     if (!ext) {
       if (logp_inter >= pthre_inter
@@ -306,7 +282,7 @@ void SamplePairEach::peakcall_withInput(const vChrArray &vReadArray, const std::
           && ratio_i >= ethre
           && ChIParray[i] >= ipm)
         {
-          vPeak[chrname].emplace_back(Peak(chrname, binsize, i*binsize, (i+1)*binsize -1, ChIParray[i], logp_inter, Inputarray[i], logp_enrich));
+          peaks.emplace_back(Peak(chrname, binsize, i*binsize, (i+1)*binsize -1, ChIParray[i], logp_inter, Inputarray[i], logp_enrich));
           ext=1;
         }
     } else {
@@ -315,11 +291,12 @@ void SamplePairEach::peakcall_withInput(const vChrArray &vReadArray, const std::
           && ratio_i >= ethre
           && ChIParray[i] >= ipm)
         {
-          vPeak[chrname][vPeak[chrname].size()-1].renew((i+1)*binsize -1, ChIParray[i], logp_inter, Inputarray[i], logp_enrich);
+          peaks.back().renew((i+1)*binsize -1, ChIParray[i], logp_inter, Inputarray[i], logp_enrich);
         }
       else ext=0;
     }
   }
+  setPeakIndex(chrname, peaks);
 
   return;
 }
@@ -328,26 +305,64 @@ void SamplePairEach::peakcall_onlyChIP(const vChrArray &vReadArray, const std::s
                                        const double pthre_inter, const double ipm)
 {
   int32_t ext(0);
+  std::vector<Peak> peaks;
 
   const WigArray &ChIParray = vReadArray.getArray(argvChIP).array;
+  const std::vector<double> &pinter(vReadArray.getSignalTrack(*this).getPinter());
 
   for (size_t i=0; i<ChIParray.size(); ++i) {
     double val(ChIParray[i]);
-    double logp_inter(getlogp_Poisson(val, ChIParray.getLocalAverage(i, binsize)));
+    double logp_inter(pinter[i]);
 
     if (!ext) {
       if (logp_inter >= pthre_inter && ChIParray[i] >= ipm) {
-        vPeak[chrname].emplace_back(Peak(chrname, binsize, i*binsize, (i+1)*binsize -1, val, logp_inter));
+        peaks.emplace_back(Peak(chrname, binsize, i*binsize, (i+1)*binsize -1, val, logp_inter));
         ext=1;
       }
     } else {
-      if (logp_inter >= pthre_inter && ChIParray[i] >= ipm) vPeak[chrname][vPeak[chrname].size()-1].renew((i+1)*binsize -1, val, logp_inter);
+      if (logp_inter >= pthre_inter && ChIParray[i] >= ipm) peaks.back().renew((i+1)*binsize -1, val, logp_inter);
       else ext=0;
     }
   }
+  setPeakIndex(chrname, peaks);
+
   return;
 }
 
+void SamplePairEach::setPeakIndex(const std::string &chrname, const std::vector<Peak> &peaks)
+{
+  // replaced if called again (SERVE calls peaks again when a released chromosome is loaded again)
+  IntervalIndex<Peak> &index = vPeak[chrdict().intern(chrname)];
+  index = IntervalIndex<Peak>();
+  for (auto &x: peaks) index.add(x.start, x.end, x);
+  index.index();
+}
+
+void SamplePairEach::writePeakCache(const std::string &filename, const std::string &chrname) const
+{
+  std::ofstream out(filename);
+  out << std::setprecision(17);
+  for (auto &x: getPeakChr(chrdict().getID(chrname)).getValues()) {
+    out << x.start << "\t" << x.end << "\t" << x.summit << "\t"
+        << x.pileup << "\t" << x.pileup_input << "\t" << x.p_inter << "\t" << x.p_enr << "\n";
+  }
+}
+
+void SamplePairEach::readPeakCache(const std::string &filename, const std::string &chrname)
+{
+  std::ifstream in(filename);
+  if (!in) PRINTERR_AND_EXIT("cannot open " << filename);
+
+  std::vector<Peak> peaks;
+  int32_t start, end, summit;
+  double pileup, pileup_input, p_inter, p_enr;
+  while (in >> start >> end >> summit >> pileup >> pileup_input >> p_inter >> p_enr) {
+    peaks.emplace_back(Peak(chrname, binsize, start, end, pileup, p_inter, pileup_input, p_enr));
+    peaks.back().summit = summit;
+  }
+  setPeakIndex(chrname, peaks);
+}
+
 void SamplePairEach::print() const
 {
   std::cout << boost::format("ChIP: %1% label: %2% peaklist: %3%\n") % argvChIP % label % peak_argv;
@@ -355,84 +370,132 @@ void SamplePairEach::print() const
   std::cout << boost::format("   binsize: %1%\n") % binsize;
 }
 
-void SamplePairEach::genwig_openfilestream(const std::string &prefix, WigType _oftype, int32_t _ofvaluetype)
+void SamplePairEach::genwig_openfilestream(const std::string &prefix,
+                                           const std::vector<WigType> &vtype,
+                                           const std::vector<int32_t> &vvalue)
 {
-  oftype = _oftype;
-  ofvaluetype = _ofvaluetype;
+  genwig.clear();
+  for (auto value: vvalue) {
+    if (GenwigFile::requiresInput(value) && !InputExists()) continue;
+    for (auto type: vtype) genwig.emplace_back(prefix, label, binsize, type, value);
+  }
+}
 
-  if (ofvaluetype == 0)      genwig_filename = prefix + "." + label + ".enrich."  + std::to_string(binsize);
-  else if (ofvaluetype == 1) genwig_filename = prefix + "." + label + ".pinter."  + std::to_string(binsize);
-  else if (ofvaluetype == 2) genwig_filename = prefix + "." + label + ".penrich." + std::to_string(binsize);
+GenwigFile::GenwigFile(const std::string &prefix, const std::string &label, const int32_t b,
+                       const WigType type, const int32_t valuetype):
+  oftype(type), ofvaluetype(valuetype), binsize(b)
+{
+  if (ofvaluetype == 0)      filename = prefix + "." + label + ".enrich."  + std::to_string(binsize);
+  else if (ofvaluetype == 1) filename = prefix + "." + label + ".pinter."  + std::to_string(binsize);
+  else if (ofvaluetype == 2) filename = prefix + "." + label + ".penrich." + std::to_string(binsize);
+  else {
+    PRINTERR_AND_EXIT("Invalid outputvaluetype: " << ofvaluetype);
+  }
 
   if (oftype==WigType::COMPRESSWIG || oftype==WigType::UNCOMPRESSWIG) {
-    genwig_filename += ".wig";
-    File = fopen(genwig_filename.c_str(), "w");
+    filename += ".wig";
+    File = fopen(filename.c_str(), "w");
     fprintf(File, "track type=wiggle_0\tname=\"%s\"\tdescription=\"Merged tag counts for every %d bp\"\n",
-            genwig_filename.c_str(), binsize);
+            filename.c_str(), binsize);
   } else if (oftype==WigType::BEDGRAPH) {
-    genwig_filename += ".bedGraph";
-    File = fopen(genwig_filename.c_str(), "w");
+    filename += ".bedGraph";
+    File = fopen(filename.c_str(), "w");
 
   } else if (oftype==WigType::BIGWIG) {
-    genwig_filename += ".bw";
+    filename += ".bw";
     int32_t fd(0);
-    char tmpfile[] = "/tmp/drompa+_bedGraph_XXXXXX";
-    if ((fd = mkstemp(tmpfile)) < 0){
+    char tmp[] = "/tmp/drompa+_bedGraph_XXXXXX";
+    if ((fd = mkstemp(tmp)) < 0){
       perror("mkstemp");
     }
-    File = fopen(tmpfile, "w");
-    genwig_tmpfile = std::string(tmpfile);
+    File = fopen(tmp, "w");
+    tmpfile = std::string(tmp);
   } else {
     PRINTERR_AND_EXIT("Invalid genwig_oftype.");
   }
+  if (!File) PRINTERR_AND_EXIT("cannot open " << filename);
 
-  std::cout << "Output filename: " << genwig_filename << std::endl;
-  return;
+  std::cout << "Output filename: " << filename << std::endl;
 }
 
-void SamplePairEach::sort_bedGraph(const std::string &filename)
+void GenwigFile::write(const std::vector<double> &values, const std::string &chrname, const int32_t chrlen,
+                       const std::string &segfile)
+{
+  WigArray wigarray(values.size(), 0);
+  for (size_t i=0; i<values.size(); ++i) wigarray.setval(i, values[i]);
+
+  FILE *out(File);
+  if (segfile != "" && !(out = fopen(segfile.c_str(), "w"))) PRINTERR_AND_EXIT("cannot open " << segfile);
+
+  bool showzero(true);
+  bool isfloat(true);
+  if (oftype==WigType::COMPRESSWIG || oftype==WigType::UNCOMPRESSWIG) {
+    fprintf(out, "variableStep\tchrom=%s\tspan=%d\n", chrname.c_str(), binsize);
+    wigarray.outputAsWig(out, binsize, showzero, isfloat);
+  } else if (oftype==WigType::BEDGRAPH || oftype==WigType::BIGWIG) {
+    wigarray.outputAsBedGraph(out, binsize, chrname, chrlen-1, showzero, isfloat);
+  }
+
+  if (segfile != "") {
+    fclose(out);
+    appendSegment(segfile);
+  }
+}
+
+void GenwigFile::appendSegment(const std::string &segfile)
+{
+  FILE *in(fopen(segfile.c_str(), "r"));
+  if (!in) PRINTERR_AND_EXIT("cannot open " << segfile);
+
+  char buf[1<<16];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) fwrite(buf, 1, n, File);
+  fclose(in);
+}
+
+void GenwigFile::sort_bedGraph(const std::string &bedgraph)
 {
   printf("sort bedGraph...\n");
-  std::string tempfile = filename + ".tmpfile";
-  std::string command = "mv " + filename + " " + tempfile;
-  if (system(command.c_str())) PRINTERR_AND_EXIT("mv " + filename + " " + tempfile + " failed.");
+  std::string tempfile = bedgraph + ".tmpfile";
+  std::string command = "mv " + bedgraph + " " + tempfile;
+  if (system(command.c_str())) PRINTERR_AND_EXIT("mv " + bedgraph + " " + tempfile + " failed.");
 
-  std::ofstream out(filename);
+  std::ofstream out(bedgraph);
   //      out << boost::format("browser position %1%:%2%-%3%\n") % p.genome.chr[1].getrefname() % 0 % (p.genome.chr[1].getlen()/100);
   out << "browser hide all" << std::endl;
   out << "browser pack refGene encodeRegions" << std::endl;
   out << "browser full altGraph" << std::endl;
   out << boost::format("track type=bedGraph name=\"%1%\" description=\"Merged tag counts for every %2% bp\" visibility=full\n")
-    % genwig_filename % binsize;
+    % filename % binsize;
   out.close();
 
-  command = "sort -k1,1 -k2,2n " + tempfile + " >> " + filename;
+  command = "sort -k1,1 -k2,2n " + tempfile + " >> " + bedgraph;
   if (system(command.c_str())) PRINTERR_AND_EXIT("sorting bedGraph failed.");
   remove(tempfile.c_str());
 }
 
-void SamplePairEach::genwig_closefilestream(const std::string &genometablefilename)
+void GenwigFile::close(const std::string &genometablefilename)
 {
   if (oftype==WigType::COMPRESSWIG || oftype==WigType::UNCOMPRESSWIG) {
     fclose(File);
     if (oftype==WigType::COMPRESSWIG) {
-      std::string command = "gzip -f " + genwig_filename;
+      std::string command = "gzip -f " + filename;
       if (system(command.c_str())) PRINTERR_AND_EXIT("gzip .wig failed.");
     }
   } else if (oftype==WigType::BEDGRAPH) {
     fclose(File);
-    sort_bedGraph(genwig_filename);
+    sort_bedGraph(filename);
 
   } else if (oftype==WigType::BIGWIG) {
     fclose(File);
-    sort_bedGraph(genwig_tmpfile);
+    sort_bedGraph(tmpfile);
 
-    std::string command = "bedGraphToBigWig " + genwig_tmpfile + " " + genometablefilename + " " + genwig_filename;
+    std::string command = "bedGraphToBigWig " + tmpfile + " " + genometablefilename + " " + filename;
     if (system(command.c_str())) {
-      unlink(genwig_tmpfile.c_str());
+      unlink(tmpfile.c_str());
       std::cerr << "Error: command " << command << "return nonzero status. "
                 << "Add the PATH to 'DROMPAplus/otherbins'." << std::endl;
     }
-    unlink(genwig_tmpfile.c_str());
+    unlink(tmpfile.c_str());
   }
 }
@@ -15,7 +15,7 @@ class SampleInfo {
   WigType iftype;
   int32_t binsize;
   int32_t totalreadnum;
-  std::unordered_map<std::string, int32_t> totalreadnum_chr;
+  ChrVector<int32_t> totalreadnum_chr;
   std::string prefix;
 
   void setbinsize(std::string &v, const int32_t b);
@@ -35,7 +35,7 @@ public:
   WigType getiftype() const { return iftype; }
 
   int32_t gettotalreadnum() const { return totalreadnum; }
-  const std::unordered_map<std::string, int32_t>& gettotalreadnum_chr() const & {
+  const ChrVector<int32_t>& gettotalreadnum_chr() const & {
     return totalreadnum_chr;
   }
 };
@@ -61,17 +61,41 @@ public:
   }
 };
 
-class SamplePairEach {
-  FILE* File;
-  std::string genwig_filename;
-  std::string genwig_tmpfile;
+/* an output file of GENWIG
+   ofvaluetype 0: ChIP/Input enrichment, 1: P-value (ChIP internal), 2: P-value (ChIP/Input enrichment) */
+class GenwigFile {
   WigType oftype;
   int32_t ofvaluetype;
+  int32_t binsize;
+  std::string filename;
+  std::string tmpfile;  // bedGraph converted to bigWig in close()
+  FILE* File;
+
+  void sort_bedGraph(const std::string &bedgraph);
+
+public:
+  GenwigFile(const std::string &prefix, const std::string &label, const int32_t b,
+             const WigType type, const int32_t valuetype);
+
+  static bool requiresInput(const int32_t valuetype) { return valuetype != 1; }
+  int32_t getValueType() const { return ofvaluetype; }
+
+  // segfile: written to segfile and then appended to the output (kept for the next run)
+  void write(const std::vector<double> &values, const std::string &chrname, const int32_t chrlen,
+             const std::string &segfile="");
+  void appendSegment(const std::string &segfile);
+  void close(const std::string &genometablefilename);
+};
+
+class SamplePairEach {
+  std::vector<GenwigFile> genwig;
 
   int32_t binsize;
 
-  std::unordered_map<std::string, std::vector<bed>> vbedregions;
-  std::unordered_map<std::string, std::vector<Peak>> vPeak;
+  BedIndex<bed> vbedregions;
+  BedIndex<Peak> vPeak;
+
+  void setPeakIndex(const std::string &chrname, const std::vector<Peak> &peaks);
 
   class yScale {
   public:
@@ -89,14 +113,12 @@ public:
   yScale scale;
 
   SamplePairEach():
-    genwig_filename(""), oftype(WigType::BEDGRAPH), binsize(0), argvChIP(""), argvInput(""), peak_argv(""), label(""), ratio(1)
+    binsize(0), argvChIP(""), argvInput(""), peak_argv(""), label(""), ratio(1)
   {}
   SamplePairEach(const std::string &str, const vSampleInfo &vsinfo);
 
   void setScalingFactor(const int32_t normtype, const vChrArray &vReadArray, const std::string &chrname);
 
-  void genEnrichWig(const vChrArray &vReadArray, const std::string &chrname, const int32_t chrlen);
-
   void peakcall_withInput(const vChrArray &vReadArray, const std::string &chrname,
                           const double pthre_inter, const double pthre_enrich,
                           const double ethre, const double ipm);
@@ -114,7 +136,7 @@ public:
     v.printHead(out);
     int32_t num(0);
     for (auto &x: vPeak) {
-      for (auto &peak: x.second) peak.print(out, num++);
+      for (auto &peak: x.getValues()) peak.print(out, num++);
     }
     out.close();
 
@@ -123,22 +145,25 @@ public:
     if(system(command.c_str())) std::cerr << "Warning: peak BED file cannot be generated.";
   }
 
-  std::vector<bed> getBedChr(const std::string &chrname) const {
-    if (vbedregions.find(rmchr(chrname)) != vbedregions.end()) return vbedregions.at(rmchr(chrname));
-    else return std::vector<bed>();
+  void writePeakCache(const std::string &filename, const std::string &chrname) const;
+  void readPeakCache(const std::string &filename, const std::string &chrname);
+
+  const IntervalIndex<bed> & getBedChr(const int32_t chrid) const {
+    return vbedregions.get(chrid);
   }
-  std::vector<Peak> getPeakChr(const std::string &chrname) const {
-    if (vPeak.find(chrname) != vPeak.end()) return vPeak.at(chrname);
-    else return std::vector<Peak>();
+  const IntervalIndex<Peak> & getPeakChr(const int32_t chrid) const {
+    return vPeak.get(chrid);
   }
   void print() const;
   int32_t getbinsize() const { return binsize; }
   bool BedExists() const { return peak_argv != ""; }
   bool InputExists() const { return argvInput != ""; }
 
-  void genwig_openfilestream(const std::string &prefix, WigType _oftype, int32_t _ofvaluetype);
-  void sort_bedGraph(const std::string &filename);
-  void genwig_closefilestream(const std::string &genometablefilename);
+  // files of the value types (vvalue) in each format (vtype); types that need Input are skipped without Input
+  void genwig_openfilestream(const std::string &prefix,
+                             const std::vector<WigType> &vtype,
+                             const std::vector<int32_t> &vvalue);
+  std::vector<GenwigFile> & getGenwigFiles() { return genwig; }
 
 };
 
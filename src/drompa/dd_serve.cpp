@@ -0,0 +1,183 @@
+/* Copyright(c) Ryuichiro Nakato <rnakato@iam.u-tokyo.ac.jp>
+ * All rights reserved.
+ */
+#include <sstream>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include "dd_serve.hpp"
+#include "../submodules/SSP/common/inline.hpp"
+#include "../submodules/SSP/common/util.hpp"
+
+namespace {
+  namespace pt = boost::property_tree;
+
+  std::string toJson(const pt::ptree &tree) {
+    std::ostringstream ss;
+    pt::write_json(ss, tree, false);
+    std::string str(ss.str());
+    if (!str.empty() && str.back() == '\n') str.pop_back();
+    return str;
+  }
+
+  bool isWritable(const std::string &filename) {
+    size_t p(filename.rfind('/'));
+    std::string dir(p == std::string::npos ? "." : filename.substr(0, p+1));
+    return !access(dir.c_str(), W_OK);
+  }
+
+  void sendAll(const int32_t fd, const std::string &str) {
+    size_t sent(0);
+    while (sent < str.size()) {
+      ssize_t n(send(fd, str.data() + sent, str.size() - sent, MSG_NOSIGNAL));
+      if (n <= 0) return;
+      sent += n;
+    }
+  }
+}
+
+Figure & DrompaServer::getFigure(const chrsize &chr)
+{
+  auto itr = figures.find(chr.getname());
+  if (itr == figures.end()) {
+    // released before loading so that at most --maxchr chromosomes are in memory
+    if (static_cast<int32_t>(figures.size()) >= p.getMaxChr()) {
+      std::cout << "Release chr" << lru.back() << std::endl;
+      figures.erase(lru.back());
+      lru.pop_back();
+    }
+    std::cout << "Load " << chr.getrefname() << std::endl;
+    current = nullptr;  // the scaling factors are set by the new Figure
+    itr = figures.emplace(chr.getname(), std::unique_ptr<Figure>(new Figure(p, chr))).first;
+    if (p.thre.sigtest) itr->second->peakcall(p, chr.getrefname());
+  } else {
+    lru.remove(chr.getname());
+    if (current != &chr) itr->second->setScalingFactor(p);
+  }
+  lru.push_front(chr.getname());
+  current = &chr;
+  return *itr->second;
+}
+
+bool DrompaServer::handleRequest(const std::string &request, std::string &response)
+{
+  pt::ptree req, res;
+  bool running(true);
+
+  try {
+    std::istringstream ss(request);
+    pt::read_json(ss, req);
+    if (req.count("id")) res.put("id", req.get<std::string>("id"));
+
+    std::string command(req.get<std::string>("command"));
+    if (command == "quit") {
+      running = false;
+    } else if (command == "draw" || command == "profile") {
+      std::string name(rmchr(req.get<std::string>("chr")));
+      auto chr = std::find_if(p.gt.begin(), p.gt.end(), [&name] (const chrsize &x) { return x.getname() == name; });
+      if (chr == p.gt.end()) throw std::runtime_error("unknown chromosome: " + req.get<std::string>("chr"));
+
+      int32_t start(req.get<int32_t>("start", 0));
+      int32_t end(req.get<int32_t>("end", chr->getlen()));
+      if (start < 0 || start >= end || end > chr->getlen()) {
+        throw std::runtime_error((boost::format("invalid region: %1%-%2%") % start % end).str());
+      }
+      std::string output(req.get<std::string>("output"));
+      if (!isWritable(output)) throw std::runtime_error("cannot write " + output);
+
+      std::vector<std::string> files;
+      Figure &fig(getFigure(*chr));
+      if (command == "draw") {
+        std::string format(req.get<std::string>("format", "pdf"));
+        if (format != "pdf" && format != "png") throw std::runtime_error("invalid format: " + format);
+        files = fig.DrawRegion(p, start, end, output, format == "png");
+      } else {
+        fig.WriteRegionValues(start, end, output);
+        files.emplace_back(output);
+      }
+
+      pt::ptree vfile;
+      for (auto &x: files) {
+        pt::ptree f;
+        f.put("", x);
+        vfile.push_back(std::make_pair("", f));
+      }
+      res.add_child("files", vfile);
+    } else {
+      throw std::runtime_error("unknown command: " + command);
+    }
+    res.put("status", "ok");
+  } catch (const std::exception &e) {
+    res.put("status", "error");
+    res.put("message", e.what());
+  }
+
+  response = toJson(res);
+  return running;
+}
+
+void DrompaServer::serveStdin()
+{
+  // responses are written to stdout; messages while drawing are sent to stderr
+  std::cout << std::flush;
+  fflush(stdout);
+  FILE *out(fdopen(dup(STDOUT_FILENO), "w"));
+  dup2(STDERR_FILENO, STDOUT_FILENO);
+
+  std::string lineStr, response;
+  bool running(true);
+  while (running && getline(std::cin, lineStr)) {
+    if (!lineStr.empty() && lineStr.back() == '\r') lineStr.pop_back();
+    if (lineStr.empty()) continue;
+    running = handleRequest(lineStr, response);
+    fprintf(out, "%s\n", response.c_str());
+    fflush(out);
+  }
+  fclose(out);
+}
+
+void DrompaServer::serveSocket(const std::string &path)
+{
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) PRINTERR_AND_EXIT("socket path is too long: " << path);
+  strcpy(addr.sun_path, path.c_str());
+
+  int32_t sock(socket(AF_UNIX, SOCK_STREAM, 0));
+  if (sock < 0) PRINTERR_AND_EXIT("cannot create socket.");
+  unlink(path.c_str());
+  if (bind(sock, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || listen(sock, 8) < 0) {
+    PRINTERR_AND_EXIT("cannot listen on " << path);
+  }
+  std::cout << "Listening on " << path << std::endl;
+
+  // one client at a time
+  bool running(true);
+  while (running) {
+    int32_t conn(accept(sock, nullptr, nullptr));
+    if (conn < 0) continue;
+
+    std::string buf, response;
+    char chunk[4096];
+    ssize_t n;
+    while (running && (n = read(conn, chunk, sizeof(chunk))) > 0) {
+      buf.append(chunk, n);
+      size_t pos;
+      while (running && (pos = buf.find('\n')) != std::string::npos) {
+        std::string lineStr(buf.substr(0, pos));
+        buf.erase(0, pos+1);
+        if (!lineStr.empty() && lineStr.back() == '\r') lineStr.pop_back();
+        if (lineStr.empty()) continue;
+        running = handleRequest(lineStr, response);
+        sendAll(conn, response + "\n");
+      }
+    }
+    close(conn);
+  }
+  close(sock);
+  unlink(path.c_str());
+}
@@ -0,0 +1,39 @@
+/* Copyright(c) Ryuichiro Nakato <rnakato@iam.u-tokyo.ac.jp>
+ * All rights reserved.
+ */
+#ifndef _DD_SERVE_H_
+#define _DD_SERVE_H_
+
+#include <map>
+#include <list>
+#include <memory>
+#include <string>
+#include "dd_draw.hpp"
+
+/* drompa+ SERVE: options, annotations and samples are read once and the arrays of
+ * up to --maxchr chromosomes are kept after their requests (the least recently requested one is released).
+ * Errors in reading the data of a request are returned as error responses.
+ * Requests and responses are JSON objects, one per line:
+ *   {"id": "1", "command": "draw", "chr": "chr1", "start": 1000000, "end": 2000000, "format": "png", "output": "a.png"}
+ *   {"id": "2", "command": "profile", "chr": "chr1", "start": 1000000, "end": 2000000, "output": "a.tsv"}
+ *   {"command": "quit"}
+ *   -> {"id": "1", "files": ["a.png"], "status": "ok"}
+ *      {"id": "2", "status": "error", "message": "..."} */
+class DrompaServer {
+  DROMPA::Global &p;
+  std::map<std::string, std::unique_ptr<Figure>> figures;
+  std::list<std::string> lru;  // chromosomes in figures, most recently requested first
+  const chrsize *current;  // chromosome of the scaling factors set in p.samplepair
+
+  Figure & getFigure(const chrsize &chr);
+
+public:
+  explicit DrompaServer(DROMPA::Global &_p): p(_p), current(nullptr) {}
+
+  // returns false for "quit"
+  bool handleRequest(const std::string &request, std::string &response);
+  void serveStdin();
+  void serveSocket(const std::string &path);
+};
+
+#endif /* _DD_SERVE_H_ */
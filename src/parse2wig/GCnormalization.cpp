@@ -2,7 +2,7 @@
  * All rights reserved.
  */
 #include "GCnormalization.hpp"
-#include "ReadMpbldata.hpp"
+#include "GenomeResource.hpp"
 #include "SeqStatsDROMPA.hpp"
 #include "../submodules/SSP/common/util.hpp"
 
@@ -50,55 +50,6 @@ namespace {
     }
     return array;
   }
-
-  /* return -1 when including Ns */
-  std::vector<short> makeFastaArray(const std::string &filename,
-				    const int32_t length,
-				    const int32_t flen4gc)
-  {
-    int32_t s,e, n(0);
-    int32_t state(0);
-    char c;
-    std::vector<short> array(length,0);
-    std::ifstream in(filename);
-    if (!in) PRINTERR_AND_EXIT("Could not open " << filename << ".");
-
-    while (!in.eof()) {
-      c = in.get();
-      switch(state) {
-      case 0:
-	if (c=='>') state=1;
-	break;
-      case 1:    /*header*/
-	if (c=='\n') state=2;
-	break;
-      case 2:    /*body*/
-	if (c=='>') goto final;
-	else if (isalpha((int)c)) {
-	  if (c=='G' || c=='C' || c=='g' || c=='c') {
-	    s = std::max(0, n - flen4gc);
-	    e = n;
-	    for (int32_t i=s; i<e; i++){
-	      if (array[i] != -1) array[i]++;
-	    }
-	  }else if (c=='A' || c=='T' || c=='a' || c=='t') {
-	    /* none */
-	  }else{  /* N and others */
-	    s = std::max(0, n - flen4gc);
-	    e = n;
-	    for (int32_t i=s; i<e; i++) array[i] = -1;
-	  }
-
-	  n++;
-	  if (n > length) PRINTERR_AND_EXIT("ERROR: length " << length << " < " << n);
-	}
-	break;
-      }
-    }
-
-  final:
-    return array;
-  }
 }
 
 
@@ -111,16 +62,16 @@ namespace {
 
   void GCdist::calcGCdist(const SeqStats &chr,
 			  const GCnorm &gc,
+			  GenomeResource &resource,
 			  const std::string &mpdir,
 			  const int32_t isBedOn,
 			  const std::vector<bed> &vbed,
-			  const int32_t binsize)
+			  const std::vector<int32_t> &vbinsize)
   {
-    auto mparray = readMpblBpArray(mpdir, ("chr" + chr.getname()), chr.getlen(), binsize);
-    if (isBedOn) setPeak_to_MpblBpArray(mparray, chr.getname(), vbed);
+    auto mparray = resource.getMpblBpArray(mpdir, chr.getname(), chr.getlen(), vbinsize);
+    if (isBedOn) resource.setPeak_to_MpblBpArray(mparray, chr.getname(), vbed);
 
-    std::string fastaname = gc.getGCdir() + "/chr" + chr.getname() + ".fa";
-    auto FastaArray = makeFastaArray(fastaname, chr.getlen(), flen4gc);
+    auto FastaArray = resource.getFastaArray(gc.getGCdir(), chr.getname(), chr.getlen(), flen4gc);
 
     DistGenome = makeDistGenome(FastaArray, mparray, chr.getlen(), flen4gc);
     DistRead = makeDistRead(FastaArray, mparray, chr, chr.getlen(), flen, flen4gc);
@@ -158,6 +109,7 @@ namespace {
 
   void weightReadchr(SeqStatsGenome &genome, GCdist &dist,
 		     const std::string &GCdir,
+		     GenomeResource &resource,
 		     int32_t s, int32_t e,
 		     boost::mutex &mtx)
   {
@@ -165,8 +117,7 @@ namespace {
     for (int32_t i=s; i<=e; ++i) {
       int32_t posi;
       std::cout << genome.chr[i].getname() << ".." << std::flush;
-      std::string fa = GCdir + "/chr" + genome.chr[i].getname() + ".fa";
-      auto FastaArray = makeFastaArray(fa, genome.chr[i].getlen(), dist.getflen4gc());
+      auto FastaArray = resource.getFastaArray(GCdir, genome.chr[i].getname(), genome.chr[i].getlen(), dist.getflen4gc());
 
       for (auto strand: {Strand::FWD, Strand::REV}) {
 	for (auto &x: genome.chr[i].getvReadref_notconst(strand)) {
@@ -184,14 +135,14 @@ namespace {
   }
 
 
-void weightRead(SeqStatsGenome &genome, GCdist &dist, const std::string &GCdir)
+void weightRead(SeqStatsGenome &genome, GCdist &dist, const std::string &GCdir, GenomeResource &resource)
 {
   std::cout << "Scaling reads based on GC content..." << std::flush;
 
   boost::thread_group agroup;
   boost::mutex mtx;
   for (uint i=0; i<genome.vsepchr.size(); i++) {
-    agroup.create_thread(bind(weightReadchr, boost::ref(genome), boost::ref(dist), boost::cref(GCdir), genome.vsepchr[i].s, genome.vsepchr[i].e, boost::ref(mtx)));
+    agroup.create_thread(bind(weightReadchr, boost::ref(genome), boost::ref(dist), boost::cref(GCdir), boost::ref(resource), genome.vsepchr[i].s, genome.vsepchr[i].e, boost::ref(mtx)));
   }
   agroup.join_all();
 
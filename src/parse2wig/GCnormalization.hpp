@@ -13,6 +13,7 @@
 class bed;
 class SeqStats;
 class SeqStatsGenome;
+class GenomeResource;
 
 class GCnorm {
   MyOpt::Opts opt;
@@ -79,7 +80,7 @@ class GCdist {
 
 public:
   GCdist(const int32_t l, GCnorm &gc);
-  void calcGCdist(const SeqStats &chr, const GCnorm &gc, const std::string &mpdir, const int32_t isBedOn, const std::vector<bed> &vbed, const int32_t binsize);
+  void calcGCdist(const SeqStats &chr, const GCnorm &gc, GenomeResource &resource, const std::string &mpdir, const int32_t isBedOn, const std::vector<bed> &vbed, const std::vector<int32_t> &vbinsize);
 
   int32_t getmaxGC() const { return getmaxi(DistRead); }
   double getGCweight(const int32_t i) const { return GCweight[i]; }
@@ -89,7 +90,7 @@ public:
   int32_t getflen4gc() const { return flen4gc; }
 };
 
-void weightRead(SeqStatsGenome &, GCdist &, const std::string &);
+void weightRead(SeqStatsGenome &, GCdist &, const std::string &, GenomeResource &);
 
 
 #endif /* _GCNORMALIZATION_HPP_ */
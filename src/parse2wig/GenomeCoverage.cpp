@@ -2,25 +2,27 @@
  * All rights reserved.
  */
 #include <algorithm>
+#include <random>
 #include "GenomeCoverage.hpp"
 #include "pw_gv.hpp"
-#include "ReadMpbldata.hpp"
+#include "GenomeResource.hpp"
 #include "../submodules/SSP/src/SeqStats.hpp"
 
 namespace GenomeCov {
-  std::vector<BpStatus> makeGcovArray(const Mapfile &p, const SeqStats &chr, const double r4cmp)
+  std::vector<BpStatus> makeGcovArray(const Mapfile &p, const SeqStats &chr, const double r4cmp, std::mt19937 &rng)
   {
     int32_t chrlen(chr.getlen());
+    std::uniform_int_distribution<int32_t> urand(0, RAND_MAX);
 
-    auto array = readMpblBpArray(p.getMpblBinaryDir(), ("chr" + chr.getname()), chrlen, p.wsGenome.getbinsize());
-    if(p.isBedOn()) setPeak_to_MpblBpArray(array, chr.getname(), p.getvbedref());
+    auto array = p.getResource().getMpblBpArray(p.getMpblBinaryDir(), chr.getname(), chrlen, p.wsGenome.getvbinsize());
+    if(p.isBedOn()) p.getResource().setPeak_to_MpblBpArray(array, chr.getname(), p.getvbedref());
 
     for (auto strand: {Strand::FWD, Strand::REV}) {
       for (auto &x: chr.getvReadref(strand)) {
 	if (x.duplicate) continue;
 
 	BpStatus val;
-	if(rand() >= r4cmp) val = BpStatus::COVREAD_ALL;
+	if(urand(rng) >= r4cmp) val = BpStatus::COVREAD_ALL;
 	else                val = BpStatus::COVREAD_NORM;
 
 	int32_t s(std::max(0, std::min(x.F3, x.F5)));
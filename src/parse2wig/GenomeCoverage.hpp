@@ -7,6 +7,7 @@
 #include <iostream>
 #include <fstream>
 #include <stdint.h>
+#include <random>
 #include <boost/format.hpp>
 #include "BpStatus.hpp"
 #include "../submodules/SSP/common/inline.hpp"
@@ -15,7 +16,7 @@ class SeqStats;
 class Mapfile;
 
 namespace GenomeCov {
-  std::vector<BpStatus> makeGcovArray(const Mapfile &, const SeqStats &chr, const double r4cmp);
+  std::vector<BpStatus> makeGcovArray(const Mapfile &, const SeqStats &chr, const double r4cmp, std::mt19937 &rng);
 
   class gvStats {
     virtual uint64_t getnbp() const = 0;
@@ -0,0 +1,174 @@
+/* Copyright(c) Ryuichiro Nakato <rnakato@iam.u-tokyo.ac.jp>
+ * All rights reserved.
+ */
+#include <fstream>
+#include <algorithm>
+#include "GenomeResource.hpp"
+#include "ReadMpbldata.hpp"
+#include "../submodules/SSP/common/inline.hpp"
+
+namespace {
+  void readFasta(const std::string &filename, const int32_t length,
+                 std::vector<bool> &isGC, std::vector<bool> &isN)
+  {
+    int32_t n(0);
+    int32_t state(0);
+    char c;
+    isGC.assign(length, false);
+    isN.assign(length, false);
+    std::ifstream in(filename);
+    if (!in) PRINTERR_AND_EXIT("Could not open " << filename << ".");
+
+    while (!in.eof()) {
+      c = in.get();
+      switch(state) {
+      case 0:
+	if (c=='>') state=1;
+	break;
+      case 1:    /*header*/
+	if (c=='\n') state=2;
+	break;
+      case 2:    /*body*/
+	if (c=='>') return;
+	else if (isalpha((int)c)) {
+	  if (n >= length) PRINTERR_AND_EXIT("ERROR: length " << length << " < " << n+1);
+	  if (c=='G' || c=='C' || c=='g' || c=='c') isGC[n] = true;
+	  else if (c!='A' && c!='T' && c!='a' && c!='t') isN[n] = true;  /* N and others */
+	  n++;
+	}
+	break;
+      }
+    }
+    return;
+  }
+
+  std::vector<short> makeFastaArray(const std::vector<bool> &isGC, const std::vector<bool> &isN,
+                                    const int32_t length, const int32_t flen4gc)
+  {
+    std::vector<short> array(length, 0);
+    int32_t size(isGC.size());
+    int32_t ngc(0), nN(0);
+    auto add = [&] (const int32_t n, const int32_t d) {
+      if (n < size) {
+        ngc += d * isGC[n];
+        nN  += d * isN[n];
+      }
+    };
+
+    // sliding window (i, i+flen4gc]
+    for (int32_t n=1; n<flen4gc; ++n) add(n, 1);
+    for (int32_t i=0; i<length; ++i) {
+      if (flen4gc > 0) {
+        if (i) add(i, -1);
+        add(i + flen4gc, 1);
+      }
+      array[i] = nN ? -1 : ngc;
+    }
+    return array;
+  }
+}
+
+GenomeResource::ChrResource & GenomeResource::getchr(const std::string &chrname)
+{
+  int32_t id(chrdict().intern(chrname));
+  std::lock_guard<std::mutex> lock(mtx);
+  auto &x = chrs[id];
+  if (!x) x.reset(new ChrResource());
+  return *x;
+}
+
+std::vector<BpStatus> GenomeResource::getMpblBpArray(const std::string &mpdir,
+                                                     const std::string &chrname,
+                                                     const int32_t chrlen,
+                                                     const std::vector<int32_t> &vbinsize)
+{
+  if (!keep || mpdir == "") return readMpblBpArray(mpdir, "chr" + chrname, chrlen, vbinsize);
+
+  ChrResource &x(getchr(chrname));
+  {
+    std::lock_guard<std::mutex> lock(x.mtx);
+    if (!x.on_mpbl) {
+      auto array = readMpblBpArray(mpdir, "chr" + chrname, chrlen, vbinsize);
+      x.mappable.assign(chrlen, false);
+      for (int32_t i=0; i<chrlen; ++i) x.mappable[i] = (array[i] == BpStatus::MAPPABLE);
+      x.on_mpbl = true;
+      return array;
+    }
+  }
+
+  std::vector<BpStatus> array(chrlen, BpStatus::UNMAPPABLE);
+  int32_t len(std::min(chrlen, static_cast<int32_t>(x.mappable.size())));
+  for (int32_t i=0; i<len; ++i) {
+    if (x.mappable[i]) array[i] = BpStatus::MAPPABLE;
+  }
+  return array;
+}
+
+std::vector<int32_t> GenomeResource::getMpblWigArray(const std::string &mpdir,
+                                                     const std::string &chrname,
+                                                     const int32_t binsize,
+                                                     const int32_t nbin)
+{
+  if (!keep) return readMpblWigArray(mpdir, "chr" + chrname, binsize, nbin);
+
+  ChrResource &x(getchr(chrname));
+  std::lock_guard<std::mutex> lock(x.mtx);
+  auto itr = x.mpblwig.find(binsize);
+  if (itr == x.mpblwig.end()) {
+    itr = x.mpblwig.emplace(binsize, readMpblWigArray(mpdir, "chr" + chrname, binsize, nbin)).first;
+  }
+  return itr->second;
+}
+
+void GenomeResource::setPeak_to_MpblBpArray(std::vector<BpStatus> &array,
+                                            const std::string &chrname,
+                                            const std::vector<bed> &vbed)
+{
+  if (!keep) {
+    ::setPeak_to_MpblBpArray(array, chrname, vbed);
+    return;
+  }
+
+  ChrResource &x(getchr(chrname));
+  {
+    std::lock_guard<std::mutex> lock(x.mtx);
+    if (!x.on_bed) {
+      int32_t chrid(chrdict().getID(chrname));
+      for (auto &bed: vbed) {
+        if (bed.chrid == chrid) x.vbed.emplace_back(bed.start, bed.end);
+      }
+      x.on_bed = true;
+    }
+  }
+
+  int32_t chrlen(array.size());
+  for (auto &bed: x.vbed) {
+    size_t s(std::max(0, bed.first));
+    size_t e(std::min(bed.second, chrlen-1));
+    for (size_t i=s; i<=e; ++i) array[i] = BpStatus::INBED;
+  }
+  return;
+}
+
+std::vector<short> GenomeResource::getFastaArray(const std::string &GCdir,
+                                                 const std::string &chrname,
+                                                 const int32_t length,
+                                                 const int32_t flen4gc)
+{
+  std::string filename(GCdir + "/chr" + chrname + ".fa");
+  if (!keep) {
+    std::vector<bool> isGC, isN;
+    readFasta(filename, length, isGC, isN);
+    return makeFastaArray(isGC, isN, length, flen4gc);
+  }
+
+  ChrResource &x(getchr(chrname));
+  {
+    std::lock_guard<std::mutex> lock(x.mtx);
+    if (!x.on_fasta) {
+      readFasta(filename, length, x.isGC, x.isN);
+      x.on_fasta = true;
+    }
+  }
+  return makeFastaArray(x.isGC, x.isN, length, flen4gc);
+}
@@ -0,0 +1,57 @@
+/* Copyright(c) Ryuichiro Nakato <rnakato@iam.u-tokyo.ac.jp>
+ * All rights reserved.
+ */
+#ifndef _GENOMERESOURCE_HPP_
+#define _GENOMERESOURCE_HPP_
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "BpStatus.hpp"
+#include "ChrDictionary.hpp"
+#include "extendBedFormat.hpp"
+
+/* Genome-level data of parse2wig+ (binary mappability, mappability wig, BED regions and
+ * GC contents of the reference sequence) for each chromosome.
+ * With keep=true (--batch), each is read on first use and kept as bits, so that the samples
+ * share it; otherwise it is read for each call as before. Thread-safe. */
+class GenomeResource {
+  class ChrResource {
+  public:
+    std::mutex mtx;
+    bool on_mpbl, on_bed, on_fasta;
+    std::vector<bool> mappable;
+    std::vector<bool> isGC;
+    std::vector<bool> isN;  // N and other non-ACGT bases
+    std::vector<std::pair<int32_t, int32_t>> vbed;
+    std::map<int32_t, std::vector<int32_t>> mpblwig;  // by binsize
+
+    ChrResource(): on_mpbl(false), on_bed(false), on_fasta(false) {}
+  };
+
+  bool keep;
+  std::mutex mtx;
+  ChrVector<std::unique_ptr<ChrResource>> chrs;
+
+  ChrResource & getchr(const std::string &chrname);
+
+public:
+  explicit GenomeResource(const bool _keep): keep(_keep) {}
+  GenomeResource(const GenomeResource &) = delete;
+  GenomeResource & operator=(const GenomeResource &) = delete;
+
+  // chrname without "chr"; all bases are MAPPABLE when mpdir is empty
+  std::vector<BpStatus> getMpblBpArray(const std::string &mpdir, const std::string &chrname,
+                                       const int32_t chrlen, const std::vector<int32_t> &vbinsize);
+  std::vector<int32_t> getMpblWigArray(const std::string &mpdir, const std::string &chrname,
+                                       const int32_t binsize, const int32_t nbin);
+  void setPeak_to_MpblBpArray(std::vector<BpStatus> &array, const std::string &chrname,
+                              const std::vector<bed> &vbed);
+  // the number of GC in (i, i+flen4gc] for each base i (-1 when including Ns)
+  std::vector<short> getFastaArray(const std::string &GCdir, const std::string &chrname,
+                                   const int32_t length, const int32_t flen4gc);
+};
+
+#endif /* _GENOMERESOURCE_HPP_ */
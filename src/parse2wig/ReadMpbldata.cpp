@@ -4,6 +4,7 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <atomic>
 #include <boost/filesystem.hpp>
 #include "ReadMpbldata.hpp"
 #include "../submodules/SSP/common/seq.hpp"
@@ -60,24 +61,23 @@ namespace {
 }
 
 
+// the mappability wig files of vbinsize are generated if not exist
 std::vector<BpStatus> readMpblBpArray(const std::string &mpfile,
 				      const std::string &chrname,
 				      const int32_t chrlen,
-				      const int32_t binsize)
+				      const std::vector<int32_t> &vbinsize)
 {
-  static int32_t on(0);
+  static std::atomic<bool> on(false);
 
   if(mpfile == "") {
-    if(!on) {
+    if(!on.exchange(true)) {
       std::cout << "Mappability file is not specified. All genomeic regions are considered as mappable." << std::endl;
-      on=1;
     }
     return std::vector<BpStatus>(chrlen, BpStatus::MAPPABLE);
   }
 
-  if(!on) {
+  if(!on.exchange(true)) {
     std::cout << "Reading binary mappability file.." << std::flush;
-    on=1;
   }
   std::vector<BpStatus> mparray(chrlen, BpStatus::UNMAPPABLE);
 
@@ -96,10 +96,12 @@ std::vector<BpStatus> readMpblBpArray(const std::string &mpfile,
     if(n >= chrlen-1) break;
   }
 
-  std::string mpblwigfile = mpfile + "/map_" + chrname + "." + std::to_string(binsize) + ".wig";
-  boost::filesystem::path const file(mpblwigfile + ".gz");
-  if(!boost::filesystem::exists(file)) {
-    generateMpblWigData(mpblwigfile, mparray, binsize);
+  for (auto binsize: vbinsize) {
+    std::string mpblwigfile = mpfile + "/map_" + chrname + "." + std::to_string(binsize) + ".wig";
+    boost::filesystem::path const file(mpblwigfile + ".gz");
+    if(!boost::filesystem::exists(file)) {
+      generateMpblWigData(mpblwigfile, mparray, binsize);
+    }
   }
 
   return mparray;
@@ -110,8 +112,9 @@ void setPeak_to_MpblBpArray(std::vector<BpStatus> &array,
 			    const std::vector<bed> &vbed)
 {
   int32_t chrlen(array.size());
+  int32_t chrid(chrdict().getID(chrname));
   for(auto &bed: vbed) {
-    if(bed.chr == chrname) {
+    if(bed.chrid == chrid) {
       size_t s(std::max(0, bed.start));
       size_t e(std::min(bed.end, chrlen-1));
       for(size_t i=s; i<=e; ++i) array[i] = BpStatus::INBED;
@@ -9,7 +9,7 @@
 #include "extendBedFormat.hpp"
 
 std::vector<int32_t> readMpblWigArray(const std::string &, const std::string &, const int32_t, const int32_t);
-std::vector<BpStatus> readMpblBpArray(const std::string &, const std::string &, const int32_t, const int32_t);
+std::vector<BpStatus> readMpblBpArray(const std::string &, const std::string &, const int32_t, const std::vector<int32_t> &);
 void setPeak_to_MpblBpArray(std::vector<BpStatus> &array, const std::string &chrname, const std::vector<bed> &vbed);
 
 #endif // _READMPBLDATA_HPP_
@@ -6,10 +6,13 @@
 
 #include <fstream>
 #include <numeric>
+#include <memory>
+#include <random>
 #include "WigStats.hpp"
 #include "GenomeCoverage.hpp"
 #include "GCnormalization.hpp"
 #include "ReadMpbldata.hpp"
+#include "GenomeResource.hpp"
 #include "../submodules/SSP/src/MThread.hpp"
 #include "../submodules/SSP/src/LibraryComplexity.hpp"
 #include "../submodules/SSP/src/Mapfile.hpp"
@@ -80,7 +83,6 @@ class Mapfile: private Uncopyable {
 
   std::string samplename;
   std::string oprefix;
-  std::string obinprefix;
   std::string mpdir;
   double mpthre;
   bool allchr;
@@ -93,6 +95,9 @@ class Mapfile: private Uncopyable {
   // GC bias
   int32_t maxGC;
 
+  // shared by the samples of --batch
+  std::shared_ptr<GenomeResource> resource;
+
  public:
   SeqStatsGenome genome;
   WigStatsGenome wsGenome;
@@ -111,7 +116,9 @@ class Mapfile: private Uncopyable {
     allchr(false),
     verbose(false),
     id_longestChr(0),
-    maxGC(0), genome(),
+    maxGC(0),
+    resource(std::make_shared<GenomeResource>(false)),
+    genome(),
     sspst(-1, -1, -1, 0, 600),
     complexity()
   {
@@ -161,13 +168,17 @@ class Mapfile: private Uncopyable {
 
   int32_t getmaxGC() const {return maxGC; }
 
+  GenomeResource & getResource() const { return *resource; }
+  void shareResource(const std::shared_ptr<GenomeResource> &r) { resource = r; }
+
   void calcGenomeCoverage() {
     std::cout << "Calculate genome coverage.." << std::flush;
 
     gcov.setr4cmp(genome.getnread_nonred(Strand::BOTH), genome.getnread_inbed());
 
+    std::mt19937 rng;  // fixed seed for each sample
     for(size_t i=0; i<genome.getnchr(); i++) {
-      auto array = GenomeCov::makeGcovArray(*this, genome.chr[i], gcov.getr4cmp());
+      auto array = GenomeCov::makeGcovArray(*this, genome.chr[i], gcov.getr4cmp(), rng);
       gcov.chr.emplace_back(array, gcov.getlackOfRead());
     }
     std::cout << "done." << std::endl;
@@ -189,7 +200,7 @@ class Mapfile: private Uncopyable {
     vPeak[vPeak.size()-1].renew(i, val, p);
     }*/
   const std::string & getprefix() const { return oprefix; }
-  const std::string & getbinprefix() const { return obinprefix; }
+  std::string getbinprefix(const int32_t binsize) const { return oprefix + "." + std::to_string(binsize); }
   double getmpthre() const { return mpthre; }
   const std::vector<bed> & getvbedref() const { return vbed; }
 
@@ -207,13 +218,13 @@ class Mapfile: private Uncopyable {
 		<< genome.chr[id_longestChr].getname() << std::endl;
       GCdist d(genome.dflen.getflen(), gc);
 
-      d.calcGCdist(genome.chr[id_longestChr], gc, getMpblBinaryDir(), isBedOn(), vbed, wsGenome.getbinsize());
+      d.calcGCdist(genome.chr[id_longestChr], gc, *resource, getMpblBinaryDir(), isBedOn(), vbed, wsGenome.getvbinsize());
       maxGC = d.getmaxGC();
 
       std::string filename = getprefix() + ".GCdist.tsv";
       d.outputGCweightDist(filename);
 
-      weightRead(genome, d, gc.getGCdir());
+      weightRead(genome, d, gc.getGCdir(), *resource);
 
       return;
     }
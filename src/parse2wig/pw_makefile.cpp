@@ -4,7 +4,7 @@
 #include "pw_makefile.hpp"
 #include "pw_gv.hpp"
 #include "WigStats.hpp"
-#include "ReadMpbldata.hpp"
+#include "GenomeResource.hpp"
 #include "../submodules/SSP/src/SeqStats.hpp"
 
 namespace {
@@ -16,7 +16,8 @@ namespace {
               << std::endl;
   }
 
-  void addReadToWigArray(const WigStatsGenome &p, WigArray &wigarray, const Read x, const int64_t chrlen, const int32_t readlenF3, const int32_t readlenF5)
+  // the read is added to the array of each binsize
+  void addReadToWigArray(const WigStatsGenome &p, std::vector<WigArray> &vwigarray, const Read x, const int64_t chrlen, const int32_t readlenF3, const int32_t readlenF5)
   {
     int32_t s, e;
     s = std::min(x.F3, x.F5);
@@ -30,41 +31,44 @@ namespace {
     s = std::max(0, s);
     e = std::min(e, (int32_t)(chrlen -1));
 
-    if (p.isonlyreadregion() && (e-s) > 300) { // for paired-end: consider only read region
-      int32_t sbin(s/p.getbinsize());
-      int32_t ebin((e+readlenF3)/p.getbinsize());
-      for (int32_t j=sbin; j<=ebin; ++j) wigarray.addval(j, x.getWeight());
-      sbin = (e-readlenF5)/p.getbinsize();
-      ebin = e/p.getbinsize();
-      for (int32_t j=sbin; j<=ebin; ++j) wigarray.addval(j, x.getWeight());
-    } else {
-      int32_t sbin(s/p.getbinsize());
-      int32_t ebin(e/p.getbinsize());
-      for (int32_t j=sbin; j<=ebin; ++j) wigarray.addval(j, x.getWeight());
+    for (size_t k=0; k<vwigarray.size(); ++k) {
+      WigArray &wigarray(vwigarray[k]);
+      int32_t binsize(p.bins[k].getbinsize());
+      if (p.isonlyreadregion() && (e-s) > 300) { // for paired-end: consider only read region
+        int32_t sbin(s/binsize);
+        int32_t ebin((e+readlenF3)/binsize);
+        for (int32_t j=sbin; j<=ebin; ++j) wigarray.addval(j, x.getWeight());
+        sbin = (e-readlenF5)/binsize;
+        ebin = e/binsize;
+        for (int32_t j=sbin; j<=ebin; ++j) wigarray.addval(j, x.getWeight());
+      } else {
+        int32_t sbin(s/binsize);
+        int32_t ebin(e/binsize);
+        for (int32_t j=sbin; j<=ebin; ++j) wigarray.addval(j, x.getWeight());
+      }
     }
     return;
   }
 
-  double getScaleWeight_for_totalreads(Mapfile &p, const SeqStats &chr)
+  // the genome-wide weight (GR/GD) is printed for the first chromosome
+  double getScaleWeight_for_totalreads(Mapfile &p, const int32_t id)
   {
-    static int32_t on(0);
+    const SeqStats &chr(p.genome.chr[id]);
     double w(0);
     std::string ntype(p.rpm.getType());
 
     if (ntype == "GR") {
       double dn(p.genome.getnread_nonred(Strand::BOTH));
       w = getratio(p.rpm.getnrpm(), dn);
-      if (!on) {
+      if (!id) {
         std::cout << boost::format("\ngenomic read number = %1%, after=%2%, w=%3$.3f\n") % (int64_t)dn % p.rpm.getnrpm() % w;
         if (w>2) printwarning(w);
-        on=1;
       }
     } else if (ntype == "GD") {
       w = getratio(p.rpm.getndepth(), p.genome.getdepth());
-      if (!on) {
+      if (!id) {
         std::cout << boost::format("\ngenomic depth = %1$.2f, after=%2$.2f, w=%3$.3f\n") % p.genome.getdepth() % p.rpm.getndepth() % w;
         if (w>2) printwarning(w);
-        on=1;
       }
     } else if (ntype == "CR") {
       double nm = p.rpm.getnrpm() * getratio(chr.getlenmpbl(), p.genome.getlenmpbl());
@@ -81,43 +85,50 @@ namespace {
     return w;
   }
 
-  WigArray count_and_normalize_Wigarray(Mapfile &p, const int32_t id)
+  // arrays of chromosome id for each binsize, made in one pass over the reads
+  std::vector<WigArray> count_and_normalize_Wigarray(Mapfile &p, const int32_t id)
   {
     std::cout << "chr" << p.genome.chr[id].getname() << ".." << std::flush;
-    WigArray wigarray(p.wsGenome.chr[id].getnbin(), 0);
+    std::vector<WigArray> vwigarray;
+    for (auto &x: p.wsGenome.bins) vwigarray.emplace_back(x.chr[id].getnbin(), 0);
 
     // Convert readarray to Wig
     for (auto strand: {Strand::FWD, Strand::REV}) {
       for (auto &x: p.genome.chr[id].getvReadref(strand)) {
         if (x.duplicate) continue;
-        addReadToWigArray(p.wsGenome, wigarray, x, p.genome.chr[id].getlen(), p.genome.dflen.getlenF3(), p.genome.dflen.getlenF5());
+        addReadToWigArray(p.wsGenome, vwigarray, x, p.genome.chr[id].getlen(), p.genome.dflen.getlenF3(), p.genome.dflen.getlenF5());
       }
     }
 
     // Mappability normalization
     if (p.getMpblBinaryDir() != "") {
-      int32_t binsize(p.wsGenome.getbinsize());
-      int32_t mpthre = p.getmpthre() * binsize;
-      auto mparray = readMpblWigArray(p.getMpblBinaryDir(),
-                                      ("chr" + p.genome.chr[id].getname()),
-                                      binsize,
-                                      p.wsGenome.chr[id].getnbin());
-      for (int32_t i=0; i<p.wsGenome.chr[id].getnbin(); ++i) {
-        //      std::cout << "mparray[i]: " << mparray[i] << std::endl;
-        if (mparray[i] > mpthre) wigarray.multipleval(i, getratio(binsize, mparray[i]));
+      for (size_t k=0; k<vwigarray.size(); ++k) {
+        int32_t binsize(p.wsGenome.bins[k].getbinsize());
+        int32_t nbin(p.wsGenome.bins[k].chr[id].getnbin());
+        int32_t mpthre = p.getmpthre() * binsize;
+        auto mparray = p.getResource().getMpblWigArray(p.getMpblBinaryDir(),
+                                                       p.genome.chr[id].getname(),
+                                                       binsize,
+                                                       nbin);
+        for (int32_t i=0; i<nbin; ++i) {
+          //      std::cout << "mparray[i]: " << mparray[i] << std::endl;
+          if (mparray[i] > mpthre) vwigarray[k].multipleval(i, getratio(binsize, mparray[i]));
+        }
       }
     }
 
     /* Total read normalization */
     if (p.rpm.getType() != "NONE") {
-      double w = getScaleWeight_for_totalreads(p, p.genome.chr[id]);
+      double w = getScaleWeight_for_totalreads(p, id);
       p.genome.setsizefactor(w, id);
       if (p.rpm.getType() == "GR" || p.rpm.getType() == "GD") p.genome.setsizefactor(w);
 
-      for (int32_t i=0; i<p.wsGenome.chr[id].getnbin(); ++i) { wigarray.multipleval(i, w); }
+      for (auto &wigarray: vwigarray) {
+        for (size_t i=0; i<wigarray.size(); ++i) { wigarray.multipleval(i, w); }
+      }
     }
 
-    p.wsGenome.setWigStats(id, wigarray);
+    for (size_t k=0; k<vwigarray.size(); ++k) p.wsGenome.bins[k].setWigStats(id, vwigarray[k]);
 
     // Peak calling
     /*  t1 = clock();
@@ -126,107 +137,124 @@ namespace {
         t2 = clock();
         PrintTime(t1, t2, "peakcall");*/
 
-    return wigarray;
+    return vwigarray;
   }
 
-  void outputWig(Mapfile &p, const std::string &filename)
+  // filenames[k]: file of the k-th binsize
+  void outputWig(Mapfile &p, const std::vector<std::string> &filenames)
   {
-    int32_t binsize(p.wsGenome.getbinsize());
-
-    FILE* File = fopen(filename.c_str(), "w");
-
-    fprintf(File, "track type=wiggle_0\tname=\"%s\"\tdescription=\"Merged tag counts for every %d bp\"\n", p.getSampleName().c_str(), binsize);
+    std::vector<FILE *> vFile;
+    for (size_t k=0; k<filenames.size(); ++k) {
+      FILE* File = fopen(filenames[k].c_str(), "w");
+      fprintf(File, "track type=wiggle_0\tname=\"%s\"\tdescription=\"Merged tag counts for every %d bp\"\n", p.getSampleName().c_str(), p.wsGenome.bins[k].getbinsize());
+      vFile.emplace_back(File);
+    }
 
     for (size_t i=0; i<p.genome.getnchr(); ++i) {
-      WigArray array = count_and_normalize_Wigarray(p, i);
+      std::vector<WigArray> varray = count_and_normalize_Wigarray(p, i);
 
-      fprintf(File, "variableStep\tchrom=%s\tspan=%d\n", p.genome.chr[i].getrefname().c_str(), binsize);
-      bool isfloat(false);
-      array.outputAsWig(File, binsize, p.wsGenome.isoutputzero(), isfloat);
+      for (size_t k=0; k<vFile.size(); ++k) {
+        int32_t binsize(p.wsGenome.bins[k].getbinsize());
+        fprintf(vFile[k], "variableStep\tchrom=%s\tspan=%d\n", p.genome.chr[i].getrefname().c_str(), binsize);
+        bool isfloat(false);
+        varray[k].outputAsWig(vFile[k], binsize, p.wsGenome.isoutputzero(), isfloat);
+      }
     }
-    fclose(File);
+    for (auto File: vFile) fclose(File);
 
     return;
   }
 
-  void outputBedGraph(Mapfile &p, const std::string &filename)
+  // filenames[k]: file of the k-th binsize
+  void outputBedGraph(Mapfile &p, const std::vector<std::string> &filenames)
   {
-    int32_t binsize(p.wsGenome.getbinsize());
-
-    std::ofstream out(filename);
-    out << boost::format("browser position %1%:%2%-%3%\n") % p.genome.chr[1].getrefname() % 0 % (p.genome.chr[1].getlen()/100);
-    out << "browser hide all" << std::endl;
-    out << "browser pack refGene encodeRegions" << std::endl;
-    out << "browser full altGraph" << std::endl;
-    out << boost::format("track type=bedGraph name=\"%1%\" description=\"Merged tag counts for every %2% bp\" visibility=full\n")
-      % p.getSampleName() % binsize;
-    out.close();
-
-    std::string tempfile = filename + ".tmpfile";
-
-    FILE* File = fopen(tempfile.c_str(), "w");
+    std::vector<FILE *> vFile;
+    for (size_t k=0; k<filenames.size(); ++k) {
+      std::ofstream out(filenames[k]);
+      out << boost::format("browser position %1%:%2%-%3%\n") % p.genome.chr[1].getrefname() % 0 % (p.genome.chr[1].getlen()/100);
+      out << "browser hide all" << std::endl;
+      out << "browser pack refGene encodeRegions" << std::endl;
+      out << "browser full altGraph" << std::endl;
+      out << boost::format("track type=bedGraph name=\"%1%\" description=\"Merged tag counts for every %2% bp\" visibility=full\n")
+        % p.getSampleName() % p.wsGenome.bins[k].getbinsize();
+      out.close();
+
+      std::string tempfile = filenames[k] + ".tmpfile";
+      vFile.emplace_back(fopen(tempfile.c_str(), "w"));
+    }
 
     clock_t t1,t2;
     for (size_t i=0; i<p.genome.getnchr(); ++i) {
       t1 = clock();
-      WigArray array = count_and_normalize_Wigarray(p, i);
+      std::vector<WigArray> varray = count_and_normalize_Wigarray(p, i);
       t2 = clock();
       PrintTime(t1, t2, "count_and_normalize_Wigarray");
       t1 = clock();
-      bool isfloat(false);
-      array.outputAsBedGraph(File,
-                             binsize,
-                             p.genome.chr[i].getrefname(),
-                             p.genome.chr[i].getlen() -1,
-                             p.wsGenome.isoutputzero(),
-                             isfloat);
+      for (size_t k=0; k<vFile.size(); ++k) {
+        bool isfloat(false);
+        varray[k].outputAsBedGraph(vFile[k],
+                                   p.wsGenome.bins[k].getbinsize(),
+                                   p.genome.chr[i].getrefname(),
+                                   p.genome.chr[i].getlen() -1,
+                                   p.wsGenome.isoutputzero(),
+                                   isfloat);
+      }
       t2 = clock();
       PrintTime(t1, t2, "outputAsBedGraph");
     }
-    fclose (File);
+    for (auto File: vFile) fclose(File);
 
     printf("sort bedGraph...\n");
-    std::string command = "sort -k1,1 -k2,2n "+ tempfile +" >> " + filename;
-    if (system(command.c_str())) PRINTERR_AND_EXIT("sorting bedGraph failed.");
-
-    remove(tempfile.c_str());
+    for (auto &filename: filenames) {
+      std::string tempfile = filename + ".tmpfile";
+      std::string command = "sort -k1,1 -k2,2n "+ tempfile +" >> " + filename;
+      if (system(command.c_str())) PRINTERR_AND_EXIT("sorting bedGraph failed.");
+      remove(tempfile.c_str());
+    }
 
     return;
   }
 
 }
+// the files of all binsizes are written from one pass over the reads of each chromosome
 void generate_wigfile(Mapfile &p)
 {
   printf("Convert read data to array: \n");
   WigType oftype(p.wsGenome.getWigType());
-  std::string filename(p.getbinprefix());
+  std::vector<std::string> filenames;
+  for (auto &x: p.wsGenome.bins) filenames.emplace_back(p.getbinprefix(x.getbinsize()));
 
   if (oftype==WigType::COMPRESSWIG || oftype==WigType::UNCOMPRESSWIG) {
-    filename += ".wig";
-    outputWig(p, filename);
+    for (auto &x: filenames) x += ".wig";
+    outputWig(p, filenames);
     if (oftype==WigType::COMPRESSWIG) {
-      std::string command = "gzip -f " + filename;
-      if (system(command.c_str())) PRINTERR_AND_EXIT("gzip .wig failed.");
+      for (auto &x: filenames) {
+        std::string command = "gzip -f " + x;
+        if (system(command.c_str())) PRINTERR_AND_EXIT("gzip .wig failed.");
+      }
     }
   } else if (oftype==WigType::BEDGRAPH) {
-    filename += ".bedGraph";
-    outputBedGraph(p, filename);
+    for (auto &x: filenames) x += ".bedGraph";
+    outputBedGraph(p, filenames);
   } else if (oftype==WigType::BIGWIG) {
-    int32_t fd(0);
-    char tmpfile[] = "/tmp/parse2wig+_bedGraph_XXXXXX";
-    if ((fd = mkstemp(tmpfile)) < 0){
-      perror("mkstemp");
-      //      fd = EXIT_FAILURE;
+    std::vector<std::string> tmpfiles;
+    for (size_t k=0; k<filenames.size(); ++k) {
+      char tmpfile[] = "/tmp/parse2wig+_bedGraph_XXXXXX";
+      int32_t fd(mkstemp(tmpfile));
+      if (fd < 0) perror("mkstemp");
+      else close(fd);
+      tmpfiles.emplace_back(tmpfile);
     }
-    outputBedGraph(p, std::string(tmpfile));
+    outputBedGraph(p, tmpfiles);
     printf("Convert to bigWig...\n");
-    std::string command = "bedGraphToBigWig " + std::string(tmpfile) + " " + p.genome.getGenomeTable() + " " + p.getbinprefix() + ".bw";
-    if (system(command.c_str())) {
-      unlink(tmpfile);
-      std::cerr << "Error: command " << command << "return nonzero status. "
-                << "Add the PATH to 'DROMPAplus/otherbins'." << std::endl;
+    for (size_t k=0; k<filenames.size(); ++k) {
+      std::string command = "bedGraphToBigWig " + tmpfiles[k] + " " + p.genome.getGenomeTable() + " " + filenames[k] + ".bw";
+      if (system(command.c_str())) {
+        std::cerr << "Error: command " << command << "return nonzero status. "
+                  << "Add the PATH to 'DROMPAplus/otherbins'." << std::endl;
+      }
+      unlink(tmpfiles[k].c_str());
     }
-    unlink(tmpfile);
   }
 
   printf("done.\n");
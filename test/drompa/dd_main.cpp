@@ -1,9 +1,14 @@
 /* Copyright(c) Ryuichiro Nakato <rnakato@iam.u-tokyo.ac.jp>
  * All rights reserved.
  */
+#include <unistd.h>
+#include <sys/stat.h>
 #include "dd_command.hpp"
 #include "dd_draw.hpp"
 #include "dd_profile.hpp"
+#include "dd_pdfmerge.hpp"
+#include "dd_outputcache.hpp"
+#include "dd_serve.hpp"
 
 namespace {
   void help_global(std::vector<Command> &cmds)
@@ -94,6 +99,30 @@ namespace {
     for (auto &x: p.samplepair) x.first.printPeak(p.getPrefixName());
   }
 
+  /* With --cache, outputs of each chromosome (PDF, peaks, GENWIG segments) are recorded in <prefix>.cache/manifest.tsv
+     and reused by the next run while the options and input files are unchanged. Nothing is written without it. */
+  OutputCache openManifest(const DROMPA::Global &p) {
+    if (p.isusecache()) mkdir(p.getCacheDir().c_str(), 0755);
+    return OutputCache(p.getCacheDir() + "/manifest.tsv");
+  }
+
+  std::string getChrKey(const DROMPA::Global &p, const std::string &command, const chrsize &chr) {
+    return OutputCache::getKey((boost::format("%1%\t%2%\t%3%\t%4%:%5%")
+                                % VERSION % command % p.getParamKey() % chr.getrefname() % chr.getlen()).str());
+  }
+
+  bool isChrUpToDate(const DROMPA::Global &p, const OutputCache &manifest,
+                     const std::vector<std::string> &files, const std::string &key) {
+    return p.isusecache() && !files.empty() && manifest.isUpToDate(files, key);
+  }
+
+  void setChrOutputs(const DROMPA::Global &p, OutputCache &manifest,
+                     const std::vector<std::string> &files, const std::string &key) {
+    if (!p.isusecache()) return;
+    for (auto &x: files) manifest.set(x, key);
+    manifest.save();  // saved for each chromosome to keep the progress of interrupted runs
+  }
+
 }
 
 int main(int argc, char* argv[])
@@ -106,28 +135,33 @@ int main(int argc, char* argv[])
   }
 
   int32_t cmdid = getOpts(cmds, argc, argv);
-  cmds[cmdid].execute();
+  // errors in reading sample data are thrown so that SERVE can answer them
+  try {
+    cmds[cmdid].execute();
+  } catch (const std::exception &e) {
+    PRINTERR_AND_EXIT(e.what());
+  }
 
   return 0;
 }
 
-void MergePdf(DROMPA::Global &p, const std::string &StrAllPdf)
+void MergePdf(DROMPA::Global &p, const std::vector<std::string> &vpdf)
 {
-  std::string command("cpdf " + StrAllPdf + " -o " + p.getFigFileName());
-  std::cout << "Merge PDF files \"" << command << "\"" << std::endl;
-
-  int32_t return_code = system(command.c_str());
-  if(WEXITSTATUS(return_code)) {
-    std::cerr << "Warning: command " << command << "return nonzero status." << std::endl;
+  if (p.isoutputpng()) {  // PNG files are written for each page
+    printf("done.\n");
+    return;
+  }
+  if (vpdf.empty()) {
+    std::cerr << "Warning: no PDF file to be merged." << std::endl;
+    return;
   }
 
-  /* rm _chr pdfs*/
-  if (!p.isshowchr()) {
-    command = "rm " + StrAllPdf;
-    return_code = system(command.c_str());
-    if(WEXITSTATUS(return_code)) {
-      std::cerr << "Warning: command " << command  << "return nonzero status." << std::endl;
-    }
+  std::cout << "Merge PDF files to \"" << p.getFigFileName() << "\"" << std::endl;
+  mergePdfFiles(vpdf, p.getFigFileName());
+
+  /* rm _chr pdfs (kept in <prefix>.cache for the next run with --cache) */
+  if (!p.isshowchr() && !p.isusecache()) {
+    for (auto &x: vpdf) unlink(x.c_str());
   }
   return;
 }
@@ -135,7 +169,8 @@ void MergePdf(DROMPA::Global &p, const std::string &StrAllPdf)
 
 void exec_PCSHARP(DROMPA::Global &p)
 {
-  std::string StrAllPdf("");
+  OutputCache manifest(openManifest(p));
+  std::vector<std::string> vpdf;
   for(auto &chr: p.gt) {
     if (!p.isincludeYM() && (chr.getname() == "Y" || chr.getname() == "M" || chr.getname() == "Mt")) continue;
     if (p.drawregion.getchr() != "" && p.drawregion.getchr() != chr.getname()) continue;
@@ -155,28 +190,51 @@ void exec_PCSHARP(DROMPA::Global &p)
     }
 
     // when -r is supplied
-    std::vector<bed> regionBed(p.drawregion.getRegionBedChr(chr.getname()));
+    const std::vector<bed> &regionBed(p.drawregion.getRegionBedChr(chrdict().getID(chr.getname())));
     if (p.drawregion.isRegionBed() && !regionBed.size()) continue;
 
+    // PNG pages are checked one by one in Figure::Draw
+    std::string key(getChrKey(p, "PC_SHARP", chr));
+    std::string pdffilename(p.getFigFileNameChr(chr.getrefname()));
+    std::vector<std::string> vpeakfile, outputs;
+    if (p.thre.sigtest) {
+      for (size_t i=0; i<p.samplepair.size(); ++i) {
+        vpeakfile.emplace_back(p.getCacheFileName(chr.getrefname(), ".peak" + std::to_string(i+1)));
+      }
+      outputs = vpeakfile;
+    }
+    if (p.drawparam.isshowpdf() && !p.isoutputpng()) outputs.emplace_back(pdffilename);
+
+    if (!(p.drawparam.isshowpdf() && p.isoutputpng()) && isChrUpToDate(p, manifest, outputs, key)) {
+      std::cout << chr.getrefname() << ": unchanged." << std::endl;
+      for (size_t i=0; i<vpeakfile.size(); ++i) p.samplepair[i].first.readPeakCache(vpeakfile[i], chr.getrefname());
+      if (p.drawparam.isshowpdf()) vpdf.emplace_back(pdffilename);
+      continue;
+    }
+
     std::cout << chr.getrefname() << ": " << std::flush;
-    Figure fig(p, chr);
+    Figure fig(p, chr, Figure::getDrawnRegions(p, chr));
 
     if (p.thre.sigtest) {
       std::cout << "call peak.." << std::flush;
       fig.peakcall(p, chr.getrefname());
+      if (p.isusecache()) {
+        for (size_t i=0; i<vpeakfile.size(); ++i) p.samplepair[i].first.writePeakCache(vpeakfile[i], chr.getrefname());
+      }
     }
 
     if (p.drawparam.isshowpdf()) {
       clock_t t1,t2;
       t1 = clock();
-      if (fig.Draw(p)) StrAllPdf += p.getFigFileNameChr(chr.getrefname()) + " ";
+      if (fig.Draw(p)) vpdf.emplace_back(pdffilename);
       t2 = clock();
       PrintTime(t1, t2, "MakePdf");
     }
+    setChrOutputs(p, manifest, outputs, key);
   }
 
   if (p.thre.sigtest) printPeak(p);
-  if (p.drawparam.isshowpdf()) MergePdf(p, StrAllPdf);
+  if (p.drawparam.isshowpdf()) MergePdf(p, vpdf);
   else printf("done.\n");
 
   return;
@@ -193,15 +251,28 @@ void exec_GV(DROMPA::Global &p)
 
   p.drawregion.isRegionOff();
 
-  std::string StrAllPdf("");
+  OutputCache manifest(openManifest(p));
+  std::vector<std::string> vpdf;
   for(auto &chr: p.gt) {
     if(!p.isincludeYM() && (chr.getname() == "Y" || chr.getname() == "M")) continue;
 
+    std::string key(getChrKey(p, "GV", chr));
+    std::string pdffilename(p.getFigFileNameChr(chr.getrefname()));
+    std::vector<std::string> outputs;
+    if (!p.isoutputpng()) outputs.emplace_back(pdffilename);
+
+    if (isChrUpToDate(p, manifest, outputs, key)) {
+      std::cout << chr.getrefname() << ": unchanged." << std::endl;
+      vpdf.emplace_back(pdffilename);
+      continue;
+    }
+
     Figure fig(p, chr);
-    if (fig.Draw(p)) StrAllPdf += p.getFigFileNameChr(chr.getrefname()) + " ";
+    if (fig.Draw(p)) vpdf.emplace_back(pdffilename);
+    setChrOutputs(p, manifest, outputs, key);
   }
 
-  MergePdf(p, StrAllPdf);
+  MergePdf(p, vpdf);
   return;
 }
 
@@ -226,6 +297,7 @@ void exec_MULTICI(DROMPA::Global &p)
 
     profile.WriteTSV_EachChr(p, chr);
   }
+  profile.closeMatrix();
 
   profile.printNumOfSites();
   //  profile.MakeFigure(p);
@@ -235,15 +307,37 @@ void exec_MULTICI(DROMPA::Global &p)
 
 void exec_GENWIG(DROMPA::Global &p)
 {
+  OutputCache manifest(openManifest(p));
   p.genwig_openfilestream();
 
   for(auto &chr: p.gt) {
+    std::string key(getChrKey(p, "GENWIG", chr));
+    std::vector<std::vector<std::string>> segfiles(p.samplepair.size());
+    std::vector<std::string> outputs;
+    if (p.isusecache()) {
+      for (size_t i=0; i<p.samplepair.size(); ++i) {
+        for (size_t j=0; j<p.samplepair[i].first.getGenwigFiles().size(); ++j) {
+          segfiles[i].emplace_back(p.getCacheFileName(chr.getrefname(), (boost::format(".genwig%1%_%2%") % (i+1) % (j+1)).str()));
+          outputs.emplace_back(segfiles[i].back());
+        }
+      }
+    }
+
+    if (isChrUpToDate(p, manifest, outputs, key)) {
+      std::cout << chr.getrefname() << ": unchanged." << std::endl;
+      for (size_t i=0; i<segfiles.size(); ++i) {
+        auto &vfile = p.samplepair[i].first.getGenwigFiles();
+        for (size_t j=0; j<segfiles[i].size(); ++j) vfile[j].appendSegment(segfiles[i][j]);
+      }
+      continue;
+    }
 
     std::cout << chr.getrefname() << ": " << std::flush;
     Figure fig(p, chr);
 
     std::cout << "Generate wigfile.." << std::flush;
-    fig.generateWig(chr.getrefname(), chr.getlen());
+    fig.generateWig(p, segfiles);
+    setChrOutputs(p, manifest, outputs, key);
   }
 
   p.genwig_closefilestream();
@@ -251,3 +345,12 @@ void exec_GENWIG(DROMPA::Global &p)
 
   return;
 }
+
+void exec_SERVE(DROMPA::Global &p)
+{
+  DrompaServer server(p);
+  if (p.getSocketPath() != "") server.serveSocket(p.getSocketPath());
+  else server.serveStdin();
+
+  return;
+}
@@ -0,0 +1,63 @@
+/* Copyright(c) Ryuichiro Nakato <rnakato@iam.u-tokyo.ac.jp>
+ * All rights reserved.
+ */
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cairommconfig.h>
+#include <cairomm/context.h>
+#include <cairomm/surface.h>
+#include "dd_pdfmerge.hpp"
+
+/* Round-trip check of mergePdfFiles() (run by ctest):
+ * merge cairo PDFs of 1 and 2 pages, check the page count of the output
+ * and merge the output again to parse its xref table.
+ * ctest also runs "qpdf --check" on the output when qpdf is installed. */
+namespace {
+  void writePdf(const std::string &filename, const int32_t npage, const double width, const double height)
+  {
+    const auto surface = Cairo::PdfSurface::create(filename, width, height);
+    const auto cr = Cairo::Context::create(surface);
+    for (int32_t i=0; i<npage; ++i) {
+      cr->set_source_rgb(0, 0, 0);
+      cr->move_to(50, 50);
+      cr->show_text(filename + " page " + std::to_string(i+1));
+      cr->rectangle(50, 80, width - 100, height - 130);
+      cr->stroke();
+      cr->show_page();
+    }
+  }
+
+  int32_t getPageCount(const std::string &filename)
+  {
+    std::ifstream in(filename, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    std::string data(ss.str());
+    std::string key("/Type /Pages /Kids [ ");
+    size_t p(data.rfind(key));
+    if (p == std::string::npos) return -1;
+    p = data.find("/Count ", p);
+    if (p == std::string::npos) return -1;
+    return stoi(data.substr(p + 7));
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  std::string outfile(argc > 1 ? argv[1] : "pdfmerge_check.pdf");
+  std::string in1(outfile + ".in1.pdf"), in2(outfile + ".in2.pdf"), remerged(outfile + ".remerged.pdf");
+
+  writePdf(in1, 1, 595, 842);
+  writePdf(in2, 2, 842, 595);
+  mergePdfFiles({in1, in2}, outfile);
+  mergePdfFiles({outfile}, remerged);
+
+  int32_t n(getPageCount(outfile)), nre(getPageCount(remerged));
+  if (n != 3 || nre != 3) {
+    std::cerr << "pdfmerge_check: expected 3 pages, got " << n << " (merged) and " << nre << " (re-merged)." << std::endl;
+    return 1;
+  }
+  std::cout << "pdfmerge_check: " << outfile << " has 3 pages." << std::endl;
+  return 0;
+}
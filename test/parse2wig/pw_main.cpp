@@ -7,17 +7,24 @@
 #include <vector>
 #include <fstream>
 #include <algorithm>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
 #include "pw_makefile.hpp"
 #include "version.hpp"
 #include "pw_gv.hpp"
 #include "../submodules/SSP/common/BoostOptions.hpp"
 
-void getOpts(Mapfile &p, int32_t argc, char* argv[]);
+MyOpt::Variables getOpts(Mapfile &p, int32_t argc, char* argv[]);
 void setOpts(MyOpt::Opts &);
+void runSample(Mapfile &p, const std::function<void()> &afterRead=std::function<void()>());
+void runBatch(const MyOpt::Variables &values);
 void init_dump(const Mapfile &p, const MyOpt::Variables &);
-void output_stats(const Mapfile &p);
-void output_wigstats(const Mapfile &p);
+void output_stats(const Mapfile &p, const std::string &filename);
+void output_wigstats(const Mapfile &p, const WigStatsBin &ws);
 
 void printVersion()
 {
@@ -30,7 +37,8 @@ void help_global()
   auto helpmsg = R"(
 ===============
 
-Usage: parse2wig+ [option] -i <inputfile> -o <output> --gt <genome_table>)";
+Usage: parse2wig+ [option] -i <inputfile> -o <output> --gt <genome_table>
+       parse2wig+ [option] --batch <samplesheet> --gt <genome_table>)";
 
   std::cerr << "\nparse2wig v" << VERSION << helpmsg << std::endl;
   return;
@@ -59,8 +67,17 @@ void DefineFragmentLength(Mapfile &p)
 int main(int32_t argc, char* argv[])
 {
   Mapfile p;
-  getOpts(p, argc, argv);
+  MyOpt::Variables values(getOpts(p, argc, argv));
 
+  if (values.count("batch")) runBatch(values);
+  else runSample(p);
+
+  return 0;
+}
+
+// afterRead() is called when the reads are in memory
+void runSample(Mapfile &p, const std::function<void()> &afterRead)
+{
   p.genome.initannoChr();
 
   clock_t t1,t2;
@@ -68,6 +85,7 @@ int main(int32_t argc, char* argv[])
   p.genome.read_mapfile();
   t2 = clock();
   PrintTime(t1, t2, "read_mapfile");
+  if (afterRead) afterRead();
 
   t1 = clock();
   p.complexity.checkRedundantReads(p.genome);
@@ -103,16 +121,169 @@ int main(int32_t argc, char* argv[])
 
   // p.wsGenome.printPeak(p.getbinprefix());
 
-  if (p.isverbose()) {
-    output_wigstats(p);
-    p.genome.dflen.outputDistFile(p.getprefix(), p.genome.getnread(Strand::BOTH));
+  if (p.isverbose()) p.genome.dflen.outputDistFile(p.getprefix(), p.genome.getnread(Strand::BOTH));
+  // the same stats file for each binsize, as read by drompa+ with the wig files
+  for (auto &x: p.wsGenome.bins) {
+    if (p.isverbose()) output_wigstats(p, x);
+    output_stats(p, p.getbinprefix(x.getbinsize()) + ".tsv");
   }
-  output_stats(p);
 
-  return 0;
+  return;
+}
+
+class BatchSample {
+public:
+  std::string input;
+  std::string output;
+
+  BatchSample(const std::string &i, const std::string &o): input(i), output(o) {}
+};
+
+/* one sample per line: <inputfile(s)>\t<output>
+ * empty lines and lines starting with '#' are ignored */
+std::vector<BatchSample> readSampleSheet(const std::string &filename)
+{
+  std::ifstream in(filename);
+  if (!in) PRINTERR_AND_EXIT("Could not open " << filename << ".");
+
+  std::vector<BatchSample> samples;
+  std::string lineStr;
+  while (getline(in, lineStr)) {
+    if (!lineStr.empty() && lineStr.back() == '\r') lineStr.pop_back();
+    if (lineStr.empty() || lineStr[0] == '#') continue;
+    std::vector<std::string> v;
+    ParseLine(v, lineStr, '\t');
+    if (v.size() < 2 || v[0] == "" || v[1] == "") PRINTERR_AND_EXIT("invalid line in " << filename << ": " << lineStr);
+    for (auto &x: samples) {
+      if (x.output == v[1]) PRINTERR_AND_EXIT("output " << v[1] << " appears twice in " << filename << ".");
+    }
+    samples.emplace_back(v[0], v[1]);
+  }
+  if (samples.empty()) PRINTERR_AND_EXIT("no sample in " << filename << ".");
+
+  return samples;
 }
 
-void getOpts(Mapfile &p, int32_t argc, char* argv[])
+MyOpt::Variables getSampleValues(const MyOpt::Variables &values, const BatchSample &x)
+{
+  MyOpt::Variables v(values);
+  v.erase("input");
+  v.erase("output");
+  v.insert(std::make_pair(std::string("input"),  boost::program_options::variable_value(x.input, false)));
+  v.insert(std::make_pair(std::string("output"), boost::program_options::variable_value(x.output, false)));
+  return v;
+}
+
+uint64_t getInputFileSize(const std::string &input)
+{
+  uint64_t size(0);
+  std::vector<std::string> v;
+  ParseLine(v, input, ',');
+  for (auto &x: v) {
+    isFile(x);
+    size += boost::filesystem::file_size(x);
+  }
+  return size;
+}
+
+/* Memory of the running samples for --maxmem.
+ * The reads of a sample are estimated from the size of its input files with the ratio
+ * (reads in memory / input file size) measured on the samples read so far, and the per-base arrays
+ * of the longest chromosome are added. Until the first sample is read, samples run one at a time.
+ * This is an estimate for scheduling, not a limit on the memory of the process. */
+class BatchMemory {
+  std::mutex mtx;
+  std::condition_variable cond;
+  uint64_t budget;
+  int32_t njobs;
+  uint64_t used;
+  int32_t nrunning;
+  uint64_t measuredFileSize;
+  uint64_t measuredReadMemory;
+
+  uint64_t estimate(const uint64_t filesize, const uint64_t arraysize) const {
+    return static_cast<uint64_t>(filesize * getratio(measuredReadMemory, measuredFileSize)) + arraysize;
+  }
+
+public:
+  BatchMemory(const uint64_t b, const int32_t n):
+    budget(b), njobs(n), used(0), nrunning(0), measuredFileSize(0), measuredReadMemory(0) {}
+
+  // waits until the sample can start and returns its estimated memory
+  uint64_t start(const uint64_t filesize, const uint64_t arraysize) {
+    std::unique_lock<std::mutex> lock(mtx);
+    cond.wait(lock, [&] {
+        if (!nrunning) return true;
+        if (nrunning >= njobs || !measuredFileSize) return false;
+        return used + estimate(filesize, arraysize) <= budget;
+      });
+    uint64_t memory(estimate(filesize, arraysize));
+    ++nrunning;
+    used += memory;
+    return memory;
+  }
+  // the reads of a running sample are in memory: its estimate is replaced by them
+  void setRead(uint64_t &memory, const uint64_t filesize, const uint64_t readmemory, const uint64_t arraysize) {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      measuredFileSize += filesize;
+      measuredReadMemory += readmemory;
+      used = used - memory + readmemory + arraysize;
+      memory = readmemory + arraysize;
+    }
+    cond.notify_all();
+  }
+  void finish(const uint64_t memory) {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      --nrunning;
+      used -= memory;
+    }
+    cond.notify_all();
+  }
+};
+
+/* samples start in the order of the sample sheet while the number of running samples is
+ * less than --batchjobs and their estimated memory fits in --maxmem (one sample always runs).
+ * Genome-level data is shared by the samples; the outputs of each sample are the same as separate runs.
+ * With --batchjobs > 1 the SSP routines of different samples run in threads of one process. */
+void runBatch(const MyOpt::Variables &values)
+{
+  auto samples = readSampleSheet(MyOpt::getVal<std::string>(values, "batch"));
+  double maxmem(MyOpt::getVal<double>(values, "maxmem"));
+  int32_t njobs(MyOpt::getVal<int32_t>(values, "batchjobs"));
+  auto resource = std::make_shared<GenomeResource>(true);
+  BatchMemory batchmem(maxmem * 1024 * 1024 * 1024, njobs);
+
+  std::cout << boost::format("Batch mode: %1% samples, %2% jobs, %3% GB\n") % samples.size() % njobs % maxmem;
+
+  boost::thread_group agroup;
+  for (auto &x: samples) {
+    MyOpt::Variables sv(getSampleValues(values, x));
+    auto p = std::make_shared<Mapfile>();
+    p->setValues(sv);
+    p->shareResource(resource);
+    uint64_t filesize(getInputFileSize(x.input));
+    uint64_t arraysize(3 * static_cast<uint64_t>(p->genome.chr[p->getIdLongestChr()].getlen()));
+    uint64_t memory(batchmem.start(filesize, arraysize));
+
+    init_dump(*p, sv);
+    agroup.create_thread([p, filesize, arraysize, memory, &batchmem] () mutable {
+        runSample(*p, [&] {
+            uint64_t readmemory(p->genome.getnread(Strand::BOTH) * sizeof(Read));
+            batchmem.setRead(memory, filesize, readmemory, arraysize);
+          });
+        std::cout << "sample " << p->getSampleName() << " done." << std::endl;
+        p.reset();
+        batchmem.finish(memory);
+      });
+  }
+  agroup.join_all();
+
+  return;
+}
+
+MyOpt::Variables getOpts(Mapfile &p, int32_t argc, char* argv[])
 {
   DEBUGprint_FUNCStart();
 
@@ -140,25 +311,30 @@ void getOpts(Mapfile &p, int32_t argc, char* argv[])
     help_global();
     PRINTERR_AND_EXIT("\n" << allopts);
   }
-  std::vector<std::string> opts = {"input", "output", "gt"};
+  std::vector<std::string> opts = {"gt"};
+  if (!values.count("batch")) {
+    opts.emplace_back("input");
+    opts.emplace_back("output");
+  }
   for (auto x: opts) {
     if (!values.count(x)) PRINTERR_AND_EXIT("specify --" << x << " option.");
   }
 
   try {
     notify(values);
-    p.setValues(values);
+    // for --batch, each sample is set in runBatch()
+    if (!values.count("batch")) p.setValues(values);
 
     boost::filesystem::path dir(MyOpt::getVal<std::string>(values, "odir"));
     boost::filesystem::create_directory(dir);
 
-    init_dump(p, values);
+    if (!values.count("batch")) init_dump(p, values);
   } catch(const boost::bad_any_cast& e) {
     PRINTERR_AND_EXIT(e.what());
   }
 
   DEBUGprint_FUNCend();
-  return;
+  return values;
 }
 
 void setOpts(MyOpt::Opts &allopts)
@@ -166,6 +342,19 @@ void setOpts(MyOpt::Opts &allopts)
   MyOpt::setOptIO(allopts, "parse2wigdir+");
   MyOpt::setOptPair(allopts);
   MyOpt::setOptOther(allopts);
+
+  MyOpt::Opts opt("Batch mode",100);
+  opt.add_options()
+    ("batch", boost::program_options::value<std::string>(),
+     "Sample sheet to process multiple samples in one run (one sample per line: <inputfile(s)><TAB><output>). Genome-level data (mappability, BED regions, GC contents) is read once and shared by the samples")
+    ("batchjobs",
+     boost::program_options::value<int32_t>()->default_value(1)->notifier(std::bind(&MyOpt::over<int32_t>, std::placeholders::_1, 1, "--batchjobs")),
+     "(for --batch) Maximum number of samples processed concurrently in threads (experimental: assumes the SSP routines are thread-safe for separate samples)")
+    ("maxmem",
+     boost::program_options::value<double>()->default_value(8)->notifier(std::bind(&MyOpt::over<double>, std::placeholders::_1, 0, "--maxmem")),
+     "(for --batch with --batchjobs > 1) Memory (GB) for scheduling concurrent samples. The memory of a sample is estimated from its input file size, so this is not a limit")
+    ;
+  allopts.add(opt);
   return;
 }
 
@@ -223,9 +412,8 @@ void print_SeqStats(std::ofstream &out, const T &p, const S &gcov, const Mapfile
   return;
 }
 
-void output_stats(const Mapfile &p)
+void output_stats(const Mapfile &p, const std::string &filename)
 {
-  std::string filename = p.getbinprefix() + ".tsv";
   std::ofstream out(filename);
 
   out << "parse2wig+ version " << VERSION << std::endl;
@@ -270,9 +458,9 @@ void output_stats(const Mapfile &p)
   return;
 }
 
-void output_wigstats(const Mapfile &p)
+void output_wigstats(const Mapfile &p, const WigStatsBin &ws)
 {
-  std::string filename = p.getbinprefix() + ".ReadCountDist.tsv";
+  std::string filename = p.getbinprefix(ws.getbinsize()) + ".ReadCountDist.tsv";
   std::ofstream out(filename);
 
   std::cout << "generate " << filename << ".." << std::flush;
@@ -284,9 +472,9 @@ void output_wigstats(const Mapfile &p)
   for (size_t i=0; i<p.getnchr(); ++i) out << "num of bins\tprop\t";
   out << std::endl;
 
-  for(int32_t i=0; i<p.wsGenome.getWigDistsize(); ++i) {
+  for(int32_t i=0; i<ws.getWigDistsize(); ++i) {
     out << i << "\t";
-    for (auto &x: p.wsGenome.chr) x.printWigDist(out, i);
+    for (auto &x: ws.chr) x.printWigDist(out, i);
     out << std::endl;
   }
 
@@ -324,7 +512,6 @@ void Mapfile::setValues(const MyOpt::Variables &values)
   samplename = MyOpt::getVal<std::string>(values, "output");
   id_longestChr = genome.getIdLongestChr();
   oprefix = MyOpt::getVal<std::string>(values, "odir") + "/" + MyOpt::getVal<std::string>(values, "output");
-  obinprefix = oprefix + "." + std::to_string(MyOpt::getVal<int32_t>(values, "binsize"));
 
   DEBUGprint_FUNCend();
 }